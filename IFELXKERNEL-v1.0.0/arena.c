@@ -0,0 +1,49 @@
+#include "arena.h"
+#include "heap.h"
+#include <stdbool.h>
+
+#define ARENA_ALIGN 8
+#define ARENA_CHUNK_MIN 4096
+
+static arena_chunk_t* arena_chunk(size_t size, heap_tag_t tag) {
+    arena_chunk_t* c = (arena_chunk_t*)my_malloc_tag(sizeof(arena_chunk_t) + size, tag);
+    if (!c) return NULL;
+    c->next = NULL;
+    c->size = size;
+    c->used = 0;
+    return c;
+}
+
+// Sizing the first chunk to the job means most arenas are one heap block.
+bool arena_init(arena_t* arena, size_t size_hint) {
+    arena->bytes = 0;
+    arena->tag = HEAP_TAG_ARENA;
+    arena->head = arena_chunk(size_hint < ARENA_CHUNK_MIN ? ARENA_CHUNK_MIN : size_hint, arena->tag);
+    return arena->head != NULL;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    arena_chunk_t* c = arena->head;
+    if (!c || c->size - c->used < size) {
+        c = arena_chunk(size < ARENA_CHUNK_MIN ? ARENA_CHUNK_MIN : size, arena->tag);
+        if (!c) return NULL;
+        c->next = arena->head;
+        arena->head = c;
+    }
+    void* p = (char*)(c + 1) + c->used;
+    c->used += size;
+    arena->bytes += size;
+    return p;
+}
+
+void arena_release(arena_t* arena) {
+    arena_chunk_t* c = arena->head;
+    arena->head = NULL;
+    arena->bytes = 0;
+    while (c) {
+        arena_chunk_t* next = c->next;
+        my_free(c);
+        c = next;
+    }
+}
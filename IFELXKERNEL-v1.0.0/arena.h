@@ -0,0 +1,24 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <stdbool.h>
+#include <stddef.h>
+#include "heap.h"
+
+// Bump allocator for short-lived jobs: everything is released at once.
+typedef struct arena_chunk {
+    struct arena_chunk* next;
+    size_t size;
+    size_t used;
+} __attribute__((aligned(8))) arena_chunk_t;
+
+typedef struct {
+    arena_chunk_t* head;
+    size_t bytes;
+    heap_tag_t tag;     // chunks are accounted to this heap tag
+} arena_t;
+
+bool arena_init(arena_t* arena, size_t size_hint);
+void* arena_alloc(arena_t* arena, size_t size);
+void arena_release(arena_t* arena);
+
+#endif // ARENA_H
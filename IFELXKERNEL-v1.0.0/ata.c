@@ -0,0 +1,137 @@
+#include "ata.h"
+#include "io.h"
+
+#define ATA_DATA     0x1F0
+#define ATA_COUNT    0x1F2
+#define ATA_LBA0     0x1F3
+#define ATA_LBA1     0x1F4
+#define ATA_LBA2     0x1F5
+#define ATA_DRIVE    0x1F6
+#define ATA_STATUS   0x1F7  // reads status, writes commands
+#define ATA_COMMAND  0x1F7
+#define ATA_CONTROL  0x3F6  // reads alternate status
+
+#define ATA_SR_ERR 0x01
+#define ATA_SR_DRQ 0x08
+#define ATA_SR_DF  0x20
+#define ATA_SR_BSY 0x80
+
+#define ATA_CTRL_NIEN 0x02
+
+#define ATA_CMD_READ     0x20
+#define ATA_CMD_WRITE    0x30
+#define ATA_CMD_FLUSH    0xE7
+#define ATA_CMD_IDENTIFY 0xEC
+
+#define ATA_MAX_SECTORS 256     // a sector count of 0 means 256
+#define ATA_TIMEOUT 10000000
+
+// Four alternate-status reads give the drive its 400 ns to update status
+static void ata_delay(void) {
+    for (int i = 0; i < 4; i++) inb(ATA_CONTROL);
+}
+
+static bool ata_wait_idle(void) {
+    for (uint32_t i = 0; i < ATA_TIMEOUT; i++) {
+        uint8_t s = inb(ATA_STATUS);
+        if (!(s & ATA_SR_BSY)) return !(s & (ATA_SR_ERR | ATA_SR_DF));
+    }
+    return false;
+}
+
+static bool ata_wait_drq(void) {
+    for (uint32_t i = 0; i < ATA_TIMEOUT; i++) {
+        uint8_t s = inb(ATA_STATUS);
+        if (s & ATA_SR_BSY) continue;
+        if (s & (ATA_SR_ERR | ATA_SR_DF)) return false;
+        if (s & ATA_SR_DRQ) return true;
+    }
+    return false;
+}
+
+static bool ata_command(uint32_t lba, uint32_t count, uint8_t cmd) {
+    if (!ata_wait_idle()) return false;
+    outb(ATA_DRIVE, 0xE0 | ((lba >> 24) & 0x0F));
+    outb(ATA_COUNT, (uint8_t)count);
+    outb(ATA_LBA0, (uint8_t)lba);
+    outb(ATA_LBA1, (uint8_t)(lba >> 8));
+    outb(ATA_LBA2, (uint8_t)(lba >> 16));
+    outb(ATA_COMMAND, cmd);
+    return true;
+}
+
+static bool ata_read(blkdev_t* dev, uint32_t lba, uint32_t count, void* buf) {
+    uint16_t* p = (uint16_t*)buf;
+    if (lba + count > dev->sectors) return false;
+    while (count) {
+        uint32_t n = count > ATA_MAX_SECTORS ? ATA_MAX_SECTORS : count;
+        if (!ata_command(lba, n, ATA_CMD_READ)) return false;
+        for (uint32_t i = 0; i < n; i++) {
+            ata_delay();
+            if (!ata_wait_drq()) return false;
+            insw(ATA_DATA, p, BLKDEV_SECTOR_SIZE / 2);
+            p += BLKDEV_SECTOR_SIZE / 2;
+        }
+        lba += n;
+        count -= n;
+    }
+    return true;
+}
+
+static bool ata_write(blkdev_t* dev, uint32_t lba, uint32_t count, const void* buf) {
+    const uint16_t* p = (const uint16_t*)buf;
+    if (lba + count > dev->sectors) return false;
+    while (count) {
+        uint32_t n = count > ATA_MAX_SECTORS ? ATA_MAX_SECTORS : count;
+        if (!ata_command(lba, n, ATA_CMD_WRITE)) return false;
+        for (uint32_t i = 0; i < n; i++) {
+            ata_delay();
+            if (!ata_wait_drq()) return false;
+            outsw(ATA_DATA, p, BLKDEV_SECTOR_SIZE / 2);
+            p += BLKDEV_SECTOR_SIZE / 2;
+        }
+        if (!ata_wait_idle()) return false;
+        lba += n;
+        count -= n;
+    }
+    return true;
+}
+
+static bool ata_flush(blkdev_t* dev) {
+    (void)dev;
+    return ata_command(0, 0, ATA_CMD_FLUSH) && ata_wait_idle();
+}
+
+static blkdev_t ata_disk = {
+    .name = "ata0",
+    .read = ata_read,
+    .write = ata_write,
+    .flush = ata_flush,
+};
+
+blkdev_t* ata_init(void) {
+    outb(ATA_CONTROL, ATA_CTRL_NIEN);
+    outb(ATA_DRIVE, 0xA0);
+    ata_delay();
+    // A floating bus reads all ones: no controller
+    if (inb(ATA_STATUS) == 0xFF) return NULL;
+
+    outb(ATA_COUNT, 0);
+    outb(ATA_LBA0, 0);
+    outb(ATA_LBA1, 0);
+    outb(ATA_LBA2, 0);
+    outb(ATA_COMMAND, ATA_CMD_IDENTIFY);
+    if (inb(ATA_STATUS) == 0) return NULL;
+
+    for (uint32_t i = 0; inb(ATA_STATUS) & ATA_SR_BSY; i++) {
+        if (i == ATA_TIMEOUT) return NULL;
+    }
+    // ATAPI and SATA devices answer with a signature in the LBA registers
+    if (inb(ATA_LBA1) || inb(ATA_LBA2)) return NULL;
+    if (!ata_wait_drq()) return NULL;
+
+    uint16_t id[256];
+    insw(ATA_DATA, id, 256);
+    ata_disk.sectors = id[60] | ((uint32_t)id[61] << 16);
+    return ata_disk.sectors ? &ata_disk : NULL;
+}
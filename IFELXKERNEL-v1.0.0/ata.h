@@ -0,0 +1,11 @@
+#ifndef ATA_H
+#define ATA_H
+#include "blkdev.h"
+
+// PIO driver for the master drive on the primary ATA channel (0x1F0),
+// LBA28 addressing, polled with the drive's interrupt disabled.
+
+// Probes the drive; NULL if there is no ATA disk there
+blkdev_t* ata_init(void);
+
+#endif // ATA_H
@@ -0,0 +1,285 @@
+#include "bcache.h"
+#include "heap.h"
+#include "timer.h"
+#include "mini_string.h"
+
+#define BCACHE_BUCKETS 64   // power of two
+
+typedef struct bcache_entry {
+    uint32_t block;
+    bool dirty;
+    struct bcache_entry* hash_next;
+    struct bcache_entry* lru_prev;  // toward most recently used
+    struct bcache_entry* lru_next;
+    uint8_t data[BCACHE_BLOCK_SIZE];
+} bcache_entry_t;
+
+static blkdev_t* backing = NULL;
+static blkdev_t cache_dev;
+static bcache_entry_t* buckets[BCACHE_BUCKETS];
+static bcache_entry_t* lru_head = NULL;     // most recently used
+static bcache_entry_t* lru_tail = NULL;     // next to evict
+static uint32_t entry_count = 0;
+static uint32_t dirty_count = 0;
+static uint64_t flush_at = 0;               // tick after which dirty data is overdue
+static uint32_t next_block = UINT32_MAX;    // block a sequential reader asks for next
+static uint32_t readahead_window = 0;
+static bcache_stats_t stats;
+
+// Multi-block transfers for read-ahead and coalesced write-back
+static uint8_t staging[BCACHE_READAHEAD_MAX * BCACHE_BLOCK_SIZE] __attribute__((aligned(4)));
+
+static inline uint32_t bucket_of(uint32_t block) {
+    return (block * 2654435761u) >> 26;
+}
+
+static bcache_entry_t* lookup(uint32_t block) {
+    for (bcache_entry_t* e = buckets[bucket_of(block)]; e; e = e->hash_next) {
+        if (e->block == block) return e;
+    }
+    return NULL;
+}
+
+static void hash_remove(bcache_entry_t* e) {
+    bcache_entry_t** link = &buckets[bucket_of(e->block)];
+    while (*link != e) link = &(*link)->hash_next;
+    *link = e->hash_next;
+}
+
+static void hash_insert(bcache_entry_t* e) {
+    uint32_t b = bucket_of(e->block);
+    e->hash_next = buckets[b];
+    buckets[b] = e;
+}
+
+static void lru_unlink(bcache_entry_t* e) {
+    if (e->lru_prev) e->lru_prev->lru_next = e->lru_next;
+    else lru_head = e->lru_next;
+    if (e->lru_next) e->lru_next->lru_prev = e->lru_prev;
+    else lru_tail = e->lru_prev;
+}
+
+static void lru_push_front(bcache_entry_t* e) {
+    e->lru_prev = NULL;
+    e->lru_next = lru_head;
+    if (lru_head) lru_head->lru_prev = e;
+    else lru_tail = e;
+    lru_head = e;
+}
+
+static void touch(bcache_entry_t* e) {
+    if (e == lru_head) return;
+    lru_unlink(e);
+    lru_push_front(e);
+}
+
+static bool write_back(bcache_entry_t* e) {
+    if (!backing->write(backing, e->block * BCACHE_BLOCK_SECTORS, BCACHE_BLOCK_SECTORS, e->data)) {
+        return false;
+    }
+    e->dirty = false;
+    dirty_count--;
+    stats.writebacks++;
+    return true;
+}
+
+// A free entry for `block`, detached from the hash and LRU lists: a fresh
+// allocation while under the limit, otherwise the least recently used one
+static bcache_entry_t* claim_entry(uint32_t block) {
+    bcache_entry_t* e = NULL;
+    if (entry_count < BCACHE_MAX_BLOCKS) {
+        e = (bcache_entry_t*)my_malloc_tag(sizeof(bcache_entry_t), HEAP_TAG_CACHE);
+        if (e) entry_count++;
+    }
+    if (!e) {
+        e = lru_tail;
+        if (!e || (e->dirty && !write_back(e))) return NULL;
+        hash_remove(e);
+        lru_unlink(e);
+        stats.evictions++;
+    }
+    e->block = block;
+    e->dirty = false;
+    return e;
+}
+
+static void install(bcache_entry_t* e) {
+    hash_insert(e);
+    lru_push_front(e);
+}
+
+// Fetches a missing block, plus the uncached blocks after it when the
+// reader has been moving forward sequentially
+static bcache_entry_t* fill(uint32_t block) {
+    uint32_t last = backing->sectors / BCACHE_BLOCK_SECTORS;
+    uint32_t count = 1;
+    if (block == next_block) {
+        readahead_window = readahead_window ? readahead_window * 2 : 2;
+        if (readahead_window > BCACHE_READAHEAD_MAX) readahead_window = BCACHE_READAHEAD_MAX;
+        while (count < readahead_window && block + count < last && !lookup(block + count)) count++;
+    } else {
+        readahead_window = 0;
+    }
+
+    if (!backing->read(backing, block * BCACHE_BLOCK_SECTORS, count * BCACHE_BLOCK_SECTORS, staging)) {
+        return NULL;
+    }
+    bcache_entry_t* first = NULL;
+    // Install the read-ahead blocks first so the requested one ends up
+    // most recently used and cannot be evicted by its own read-ahead
+    for (uint32_t i = count; i-- > 0;) {
+        bcache_entry_t* e = claim_entry(block + i);
+        if (!e) {
+            if (i == 0) return NULL;
+            continue;
+        }
+        memcpy(e->data, staging + i * BCACHE_BLOCK_SIZE, BCACHE_BLOCK_SIZE);
+        install(e);
+        if (i == 0) first = e;
+        else stats.readahead++;
+    }
+    return first;
+}
+
+static bcache_entry_t* get_block(uint32_t block, bool whole_write) {
+    bcache_entry_t* e = lookup(block);
+    if (e) {
+        stats.hits++;
+        touch(e);
+    } else {
+        stats.misses++;
+        if (whole_write) {
+            // Every byte is about to be replaced: no need to read it
+            e = claim_entry(block);
+            if (e) install(e);
+        } else {
+            e = fill(block);
+        }
+    }
+    if (!whole_write) next_block = block + 1;
+    return e;
+}
+
+static bool bcache_read(blkdev_t* dev, uint32_t lba, uint32_t count, void* buf) {
+    (void)dev;
+    if (lba + count > backing->sectors || lba + count < lba) return false;
+    uint8_t* out = (uint8_t*)buf;
+    while (count) {
+        uint32_t off = lba % BCACHE_BLOCK_SECTORS;
+        uint32_t n = BCACHE_BLOCK_SECTORS - off;
+        if (n > count) n = count;
+        bcache_entry_t* e = get_block(lba / BCACHE_BLOCK_SECTORS, false);
+        if (!e) return false;
+        memcpy(out, e->data + off * BLKDEV_SECTOR_SIZE, n * BLKDEV_SECTOR_SIZE);
+        out += n * BLKDEV_SECTOR_SIZE;
+        lba += n;
+        count -= n;
+    }
+    return true;
+}
+
+static bool bcache_write(blkdev_t* dev, uint32_t lba, uint32_t count, const void* buf) {
+    (void)dev;
+    if (lba + count > backing->sectors || lba + count < lba) return false;
+    const uint8_t* in = (const uint8_t*)buf;
+    while (count) {
+        uint32_t off = lba % BCACHE_BLOCK_SECTORS;
+        uint32_t n = BCACHE_BLOCK_SECTORS - off;
+        if (n > count) n = count;
+        bcache_entry_t* e = get_block(lba / BCACHE_BLOCK_SECTORS, n == BCACHE_BLOCK_SECTORS);
+        if (!e) return false;
+        memcpy(e->data + off * BLKDEV_SECTOR_SIZE, in, n * BLKDEV_SECTOR_SIZE);
+        if (!e->dirty) {
+            if (dirty_count == 0) flush_at = timer_ticks() + BCACHE_FLUSH_DELAY_MS * timer_hz() / 1000;
+            e->dirty = true;
+            dirty_count++;
+        }
+        in += n * BLKDEV_SECTOR_SIZE;
+        lba += n;
+        count -= n;
+    }
+    return true;
+}
+
+// Writes every dirty block in ascending order, merging neighbours into one
+// device transfer
+static bool write_all(void) {
+    bcache_entry_t* dirty[BCACHE_MAX_BLOCKS];
+    uint32_t n = 0;
+    for (bcache_entry_t* e = lru_head; e; e = e->lru_next) {
+        if (!e->dirty) continue;
+        uint32_t i = n++;
+        while (i > 0 && dirty[i - 1]->block > e->block) {
+            dirty[i] = dirty[i - 1];
+            i--;
+        }
+        dirty[i] = e;
+    }
+
+    for (uint32_t i = 0; i < n;) {
+        uint32_t run = 1;
+        while (i + run < n && run < BCACHE_READAHEAD_MAX &&
+               dirty[i + run]->block == dirty[i]->block + run) {
+            run++;
+        }
+        for (uint32_t k = 0; k < run; k++) {
+            memcpy(staging + k * BCACHE_BLOCK_SIZE, dirty[i + k]->data, BCACHE_BLOCK_SIZE);
+        }
+        if (!backing->write(backing, dirty[i]->block * BCACHE_BLOCK_SECTORS,
+                            run * BCACHE_BLOCK_SECTORS, staging)) {
+            return false;
+        }
+        for (uint32_t k = 0; k < run; k++) dirty[i + k]->dirty = false;
+        dirty_count -= run;
+        stats.writebacks += run;
+        i += run;
+    }
+    return true;
+}
+
+// The barrier of bcache.h: nothing written after this returns can reach
+// the device ahead of what was dirty when it was called
+static bool bcache_flush(blkdev_t* dev) {
+    (void)dev;
+    return write_all() && backing->flush(backing);
+}
+
+blkdev_t* bcache_wrap(blkdev_t* dev) {
+    if (!dev) return NULL;
+    // Anything cached belongs to the previous device
+    if (backing) write_all();
+    while (lru_head) {
+        bcache_entry_t* e = lru_head;
+        lru_unlink(e);
+        my_free(e);
+    }
+    memset(buckets, 0, sizeof(buckets));
+    memset(&stats, 0, sizeof(stats));
+    entry_count = 0;
+    dirty_count = 0;
+    next_block = UINT32_MAX;
+    readahead_window = 0;
+
+    backing = dev;
+    cache_dev.name = dev->name;
+    cache_dev.sectors = dev->sectors;
+    cache_dev.read = bcache_read;
+    cache_dev.write = bcache_write;
+    cache_dev.flush = bcache_flush;
+    return &cache_dev;
+}
+
+void bcache_idle(void) {
+    if (dirty_count && timer_ticks() >= flush_at) {
+        // On failure try again after another delay rather than every tick
+        if (!bcache_flush(&cache_dev)) {
+            flush_at = timer_ticks() + BCACHE_FLUSH_DELAY_MS * timer_hz() / 1000;
+        }
+    }
+}
+
+void bcache_get_stats(bcache_stats_t* out) {
+    *out = stats;
+    out->cached = entry_count;
+    out->dirty = dirty_count;
+}
@@ -0,0 +1,43 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+#include <stdint.h>
+#include "blkdev.h"
+
+// Write-back cache of 4 KiB blocks in front of a disk. It is itself a
+// blkdev_t, so the file system uses it exactly like the raw device.
+// Writes stay in memory until flush, eviction or the idle timer.
+//
+// Write-back does not keep the order the writes were made in: eviction
+// writes whichever block is least recently used, and flush writes in
+// ascending block order. flush is the one ordering point. It returns
+// only once every earlier write is on the device and the drive's cache
+// is committed, so anything written after it reaches the disk later.
+// Callers that need A on disk before B write A, flush, then write B.
+
+#define BCACHE_BLOCK_SECTORS 8
+#define BCACHE_BLOCK_SIZE (BCACHE_BLOCK_SECTORS * BLKDEV_SECTOR_SIZE)
+#define BCACHE_MAX_BLOCKS 64        // 256 KiB, allocated as blocks are first used
+#define BCACHE_READAHEAD_MAX 8      // blocks fetched at once by sequential reads
+#define BCACHE_FLUSH_DELAY_MS 2000  // dirty data older than this goes out when idle
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t readahead;     // blocks fetched before anyone asked for them
+    uint32_t evictions;
+    uint32_t writebacks;    // blocks written to the device
+    uint32_t cached;
+    uint32_t dirty;
+} bcache_stats_t;
+
+// Puts the cache in front of `dev` and returns the cached device; NULL
+// passes through. Only one device is cached at a time.
+blkdev_t* bcache_wrap(blkdev_t* dev);
+
+// Writes back dirty blocks once they have waited long enough; cheap to
+// call on every idle wakeup
+void bcache_idle(void);
+
+void bcache_get_stats(bcache_stats_t* out);
+
+#endif // BCACHE_H
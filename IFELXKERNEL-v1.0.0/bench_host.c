@@ -0,0 +1,348 @@
+// Host-side microbenchmarks for the freestanding allocator, VFS and string code.
+// Built natively by `make bench-host`; the kernel units are linked as-is, so
+// their symbols take precedence over the C library's for these calls.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "heap.h"
+#include "slab.h"
+#include "arena.h"
+#include "mini_string.h"
+#include "intern.h"
+#include "dirindex.h"
+#include "vfs.h"
+#include "xvr.h"
+
+#define POOL_SIZE (256u << 20)
+
+// Stand-in for the kernel's frame allocator: hands out 4 KiB-aligned chunks
+// from one static pool, so heap growth and region merging behave as on boot.
+static char pool[POOL_SIZE] __attribute__((aligned(4096)));
+static size_t pool_used = 0;
+
+static void* pool_source(size_t* size) {
+    size_t s = (*size + 4095) & ~(size_t)4095;
+    if (pool_used + s > POOL_SIZE) return NULL;
+    void* p = pool + pool_used;
+    pool_used += s;
+    *size = s;
+    return p;
+}
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static bool failed = false;
+
+static size_t live_bytes(void) {
+    heap_stats_t st;
+    heap_get_stats(&st);
+    size_t live = 0;
+    for (int t = 0; t < HEAP_TAG_COUNT; t++) live += st.tags[t].live_bytes;
+    return live;
+}
+
+static void report(const char* name, uint64_t ns, uint64_t ops, uint64_t bytes) {
+    double ns_op = ops ? (double)ns / ops : 0;
+    double mops = ns ? ops * 1e3 / ns : 0;
+    printf("%-22s %10.1f ns/op %10.2f Mop/s", name, ns_op, mops);
+    if (bytes) printf(" %9.1f MB/s", ns ? bytes * 1e3 / ns : 0);
+    printf("\n");
+}
+
+// --- allocator traces -----------------------------------------------------
+
+// Allocator traces start from a fresh peak and show their own high-water
+// mark of live heap next to the timing
+static void report_trace(const char* name, uint64_t ns, uint64_t ops) {
+    heap_stats_t st;
+    heap_get_stats(&st);
+    printf("%-22s %10.1f ns/op %10.2f Mop/s  peak %zu KB\n", name,
+           ops ? (double)ns / ops : 0, ns ? ops * 1e3 / ns : 0, st.peak_bytes / 1024);
+}
+
+static void number_name(char* buf, const char* prefix, int n, const char* suffix) {
+    char digits[12];
+    int len = 0;
+    do {
+        digits[len++] = (char)('0' + n % 10);
+        n /= 10;
+    } while (n);
+    while (*prefix) *buf++ = *prefix++;
+    while (len) *buf++ = digits[--len];
+    while (*suffix) *buf++ = *suffix++;
+    *buf = '\0';
+}
+
+#define FILES 4096
+#define LINE_LEN 80
+
+// Mirrors add_txt/del: a node from vfs_create, the body appended a line at
+// a time into the file's chunks, random deletes through vfs_unlink. Each
+// trace works in its own folder so removing it returns the folder index.
+static void bench_file_churn(void) {
+    static fs_node_t* files[FILES];
+    char line[LINE_LEN + 1];
+    memset(line, 'x', LINE_LEN);
+    line[LINE_LEN] = '\n';
+
+    heap_reset_peak();
+    fs_node_t* dir = vfs_create(root_dir, "churn", TYPE_FOLDER);
+    if (!dir) { failed = true; return; }
+    uint64_t ops = 0;
+    uint64_t t0 = now_ns();
+    for (int it = 0; it < 400000; it++) {
+        int i = rng() % FILES;
+        if (files[i]) {
+            if (!vfs_unlink(files[i])) failed = true;
+            files[i] = NULL;
+            ops++;
+            continue;
+        }
+        char name[24];
+        number_name(name, "file", i, ".txt");
+        fs_node_t* f = vfs_create(dir, name, TYPE_FILE);
+        if (!f) { failed = true; break; }
+        ops++;
+        size_t len = 64 + rng() % 6000;
+        for (size_t done = 0; done < len;) {
+            size_t n = len - done < LINE_LEN ? len - done : LINE_LEN;
+            if (!fs_append(f, line, n) || !fs_append(f, &line[LINE_LEN], 1)) failed = true;
+            done += n + 1;
+            ops += 2;
+        }
+        files[i] = f;
+    }
+    uint64_t t1 = now_ns();
+    report_trace("file churn", t1 - t0, ops);
+    for (int i = 0; i < FILES; i++) {
+        if (files[i]) vfs_unlink(files[i]);
+        files[i] = NULL;
+    }
+    vfs_unlink(dir);
+}
+
+static size_t clamp_count(size_t n, size_t max) {
+    return n < max ? n : max;
+}
+
+// Mirrors make c=: a job arena laid out like runtime_for_source from the
+// compiler's own structs, every token's text copied into it, then the .xvr
+// image rewritten in place and the arena released at once. Programs come
+// out at roughly one instruction per two tokens.
+static void bench_compiler_runs(void) {
+    static fs_node_t* images[64];
+    heap_reset_peak();
+    fs_node_t* dir = vfs_create(root_dir, "build", TYPE_FOLDER);
+    if (!dir) { failed = true; return; }
+    uint64_t ops = 0;
+    uint64_t t0 = now_ns();
+    for (int it = 0; it < 20000; it++) {
+        size_t count = 16 + rng() % 1500 + 1;
+        size_t tokens = clamp_count(count, MAX_TOKENS);
+        size_t bytecode = clamp_count(count, MAX_BYTECODE);
+        size_t vars = clamp_count(count, MAX_VARIABLES);
+        size_t consts = clamp_count(count, MAX_VARIABLES);
+        size_t stack = clamp_count(count, MAX_STACK_SIZE);
+
+        arena_t arena;
+        if (!arena_init(&arena, tokens * sizeof(Token) + bytecode * sizeof(Instruction) +
+                                vars * sizeof(Variable) + (consts + stack) * sizeof(int))) {
+            failed = true;
+            break;
+        }
+        arena_alloc(&arena, tokens * sizeof(Token));
+        arena_alloc(&arena, bytecode * sizeof(Instruction));
+        arena_alloc(&arena, vars * sizeof(Variable));
+        arena_alloc(&arena, consts * sizeof(int));
+        arena_alloc(&arena, stack * sizeof(int));
+        for (size_t t = 0; t < tokens; t++) {
+            if (!arena_alloc(&arena, sizeof(istr_t) + 2 + rng() % 8)) failed = true;
+        }
+        ops += 5 + tokens;
+
+        int slot = it % 64;
+        if (!images[slot]) {
+            char name[24];
+            number_name(name, "prog", slot, ".xvr");
+            images[slot] = vfs_create(dir, name, TYPE_FILE);
+            if (!images[slot]) { failed = true; break; }
+        }
+        fs_node_t* img = images[slot];
+        fs_truncate(img, 0);
+        img->data.file.tag = HEAP_TAG_XVR;
+        XvrHeader header = { (int)(tokens / 2), (int)(vars / 8), (int)(consts / 4) };
+        bool ok = fs_append(img, &header, sizeof(header));
+        static const char operand[4] = "x";
+        for (int k = 0; k < header.bytecode_count; k++) {
+            XvrInstruction rec = { OP_LOAD_VAR, 0, 0, 1 };
+            ok = ok && fs_append(img, &rec, sizeof(rec)) &&
+                 fs_append(img, operand, XVR_STR_SPACE(1));
+        }
+        static Variable vars_out[MAX_VARIABLES];
+        static int consts_out[MAX_VARIABLES];
+        ok = ok && fs_append(img, vars_out, header.var_count * sizeof(Variable)) &&
+             fs_append(img, consts_out, header.const_count * sizeof(int));
+        if (!ok) failed = true;
+        ops += 4 + 2 * header.bytecode_count;
+
+        arena_release(&arena);
+        ops++;
+    }
+    uint64_t t1 = now_ns();
+    report_trace("compiler runs", t1 - t0, ops);
+    for (int i = 0; i < 64; i++) {
+        if (images[i]) vfs_unlink(images[i]);
+        images[i] = NULL;
+    }
+    vfs_unlink(dir);
+}
+
+#define SMALL_SLOTS 8192
+
+static void bench_small_random(void) {
+    static void* p[SMALL_SLOTS];
+    heap_reset_peak();
+    uint64_t t0 = now_ns();
+    const int n = 2000000;
+    for (int it = 0; it < n; it++) {
+        int i = rng() % SMALL_SLOTS;
+        if (p[i]) {
+            my_free(p[i]);
+            p[i] = NULL;
+        } else {
+            p[i] = my_malloc(8 + rng() % 248);
+        }
+    }
+    uint64_t t1 = now_ns();
+    report_trace("small malloc/free", t1 - t0, n);
+    for (int i = 0; i < SMALL_SLOTS; i++) my_free(p[i]);
+}
+
+// --- string workloads -----------------------------------------------------
+
+static char big_a[65536];
+static char big_b[65536];
+static volatile size_t sink;
+
+static int bench_format(char* buf, size_t size, ...) {
+    __builtin_va_list args;
+    __builtin_va_start(args, size);
+    int n = vsnprintf(buf, size, "- %s: %d / %d, %d%%\n", args);
+    __builtin_va_end(args);
+    return n;
+}
+
+static void bench_strings(void) {
+    for (size_t i = 0; i < sizeof(big_a) - 1; i++) big_a[i] = 'a' + i % 26;
+    big_a[sizeof(big_a) - 1] = '\0';
+
+    const int reps = 2000;
+    uint64_t t0 = now_ns();
+    for (int r = 0; r < reps; r++) sink += strlen(big_a);
+    report("strlen 64K", now_ns() - t0, reps, (uint64_t)reps * sizeof(big_a));
+
+    t0 = now_ns();
+    for (int r = 0; r < reps; r++) memcpy(big_b, big_a, sizeof(big_a));
+    report("memcpy 64K", now_ns() - t0, reps, (uint64_t)reps * sizeof(big_a));
+
+    t0 = now_ns();
+    for (int r = 0; r < reps; r++) memset(big_b, r, sizeof(big_b));
+    report("memset 64K", now_ns() - t0, reps, (uint64_t)reps * sizeof(big_b));
+
+    // File-name lookups against names with a long shared prefix
+    static char names[256][64];
+    for (int i = 0; i < 256; i++) {
+        char* d = names[i];
+        const char* prefix = "project_source_file_";
+        while (*prefix) *d++ = *prefix++;
+        *d++ = 'a' + i % 26;
+        *d++ = 'a' + i / 26;
+        *d = '\0';
+    }
+    const int lookups = 200000;
+    t0 = now_ns();
+    for (int r = 0; r < lookups; r++) {
+        const char* key = names[rng() % 256];
+        for (int i = 0; i < 256; i++) {
+            if (strcmp(names[i], key) == 0) { sink += i; break; }
+        }
+    }
+    report("strcmp name scan", now_ns() - t0, lookups, 0);
+
+    // Same lookups through a directory index, interning the query first as
+    // path resolution does
+    static const istr_t* keys[256];
+    dir_index_t idx = DIR_INDEX_INIT;
+    for (int i = 0; i < 256; i++) {
+        keys[i] = intern(names[i]);
+        if (!keys[i] || !dir_index_insert(&idx, keys[i], names[i])) failed = true;
+    }
+    t0 = now_ns();
+    for (int r = 0; r < lookups; r++) {
+        const char* key = names[rng() % 256];
+        if (dir_index_find(&idx, intern_find(key)) != key) failed = true;
+    }
+    report("dir index lookup", now_ns() - t0, lookups, 0);
+    for (int i = 0; i < 256; i += 2) {
+        if (dir_index_remove(&idx, keys[i]) != names[i]) failed = true;
+    }
+    for (int i = 0; i < 256; i++) {
+        if ((dir_index_find(&idx, keys[i]) != NULL) != (i & 1)) failed = true;
+    }
+    dir_index_free(&idx);
+    for (int i = 0; i < 256; i++) intern_release(keys[i]);
+
+    char line[256];
+    t0 = now_ns();
+    for (int r = 0; r < 500000; r++) {
+        sink += bench_format(line, sizeof(line), "file data", r, -r, r % 100);
+    }
+    report("vsnprintf", now_ns() - t0, 500000, 0);
+}
+
+int main(void) {
+    heap_set_source(pool_source);
+
+    // The root folder keeps its index once it has one; give it one now so
+    // it is not mistaken for a leak below
+    fs_node_t* warm = vfs_create(root_dir, "warm", TYPE_FOLDER);
+    if (!warm || !vfs_unlink(warm)) failed = true;
+    heap_stats_t st0;
+    heap_get_stats(&st0);
+    size_t root_index = st0.tags[HEAP_TAG_FS].live_bytes;
+
+    printf("IFELXKERNEL host benchmark (heap.c, slab.c, arena.c, mini_string.c, intern.c, dirindex.c, vfs.c)\n");
+    bench_file_churn();
+    bench_compiler_runs();
+    bench_small_random();
+    bench_strings();
+
+    heap_stats_t st;
+    heap_get_stats(&st);
+    printf("heap arena %zu KB, largest free %zu KB\n",
+           st.total_bytes / 1024, st.largest_free / 1024);
+
+    // Every trace frees what it allocates; anything left over is a leak.
+    // Slabs and the intern hash table are kept for reuse by design.
+    size_t leaked = live_bytes() - st.tags[HEAP_TAG_SLAB].live_bytes -
+                    st.tags[HEAP_TAG_NAMES].live_bytes - root_index;
+    if (leaked || failed) {
+        printf("FAIL: %zu bytes still live%s\n", leaked, failed ? ", allocation failed" : "");
+        return 1;
+    }
+    return 0;
+}
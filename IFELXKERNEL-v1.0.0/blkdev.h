@@ -0,0 +1,21 @@
+#ifndef BLKDEV_H
+#define BLKDEV_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLKDEV_SECTOR_SIZE 512
+
+// A disk addressed in 512-byte sectors. Drivers fill one of these in and
+// hand it to the file system; transfers block until they complete.
+typedef struct blkdev {
+    const char* name;
+    uint32_t sectors;
+    bool (*read)(struct blkdev* dev, uint32_t lba, uint32_t count, void* buf);
+    bool (*write)(struct blkdev* dev, uint32_t lba, uint32_t count, const void* buf);
+    // Commits the drive's write cache. Also a barrier: every write made
+    // before it is durable before any write made after it
+    bool (*flush)(struct blkdev* dev);
+} blkdev_t;
+
+#endif // BLKDEV_H
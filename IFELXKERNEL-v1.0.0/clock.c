@@ -0,0 +1,103 @@
+#include "clock.h"
+#include "cpu.h"
+#include "timer.h"
+#include "idt.h"
+#include "mini_string.h"
+#include <stdarg.h>
+#include <stdbool.h>
+
+#define CALIBRATE_MS 50
+#define NS_SHIFT 24
+
+static bool have_tsc = false;
+static uint64_t tsc_base = 0;
+static uint32_t cycles_per_ms = 0;
+// ns = cycles * ns_mult >> NS_SHIFT
+static uint32_t ns_mult = 0;
+
+static void wait_tick_edge(void) {
+    uint64_t t = timer_ticks();
+    while (timer_ticks() == t) {
+        __asm__ volatile ("pause");
+    }
+}
+
+// Counts TSC cycles across a whole number of PIT ticks. Needs the timer
+// running and interrupts enabled.
+void clock_init(void) {
+    if (!(cpuid_features() & CPUID_FEAT_TSC) || !timer_hz()) return;
+
+    uint32_t ticks = CALIBRATE_MS * timer_hz() / 1000;
+    if (ticks == 0) ticks = 1;
+    uint32_t ms = ticks * 1000 / timer_hz();
+
+    wait_tick_edge();
+    uint64_t t0 = rdtsc();
+    uint64_t end = timer_ticks() + ticks;
+    while (timer_ticks() < end) {
+        __asm__ volatile ("pause");
+    }
+    uint64_t cycles = rdtsc() - t0;
+
+    cycles_per_ms = (uint32_t)div_u64(cycles, ms, NULL);
+    if (cycles_per_ms < 1000) return;  // under 1 MHz: not plausible
+    ns_mult = (uint32_t)div_u64((uint64_t)1000000 << NS_SHIFT, cycles_per_ms, NULL);
+    tsc_base = rdtsc();
+    have_tsc = true;
+}
+
+uint64_t clock_cycles(void) {
+    return have_tsc ? rdtsc() : 0;
+}
+
+uint32_t clock_mhz(void) {
+    return cycles_per_ms / 1000;
+}
+
+// The 96-bit product is taken in two 32x32 halves so nothing overflows
+uint64_t clock_now(void) {
+    if (!have_tsc) {
+        uint32_t hz = timer_hz();
+        return hz ? timer_ticks() * (1000000000u / hz) : 0;
+    }
+    uint64_t c = rdtsc() - tsc_base;
+    uint64_t lo = (uint64_t)(uint32_t)c * ns_mult;
+    uint64_t hi = (uint64_t)(uint32_t)(c >> 32) * ns_mult;
+    return (hi << (32 - NS_SHIFT)) + (lo >> NS_SHIFT);
+}
+
+void clock_format_u64(char* buf, uint64_t v) {
+    char tmp[21];
+    int n = 0;
+    do {
+        uint32_t digit;
+        v = div_u64(v, 10, &digit);
+        tmp[n++] = '0' + digit;
+    } while (v);
+    for (int i = 0; i < n; i++) buf[i] = tmp[n - 1 - i];
+    buf[n] = '\0';
+}
+
+static void format(char* buf, size_t size, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, size, fmt, args);
+    va_end(args);
+}
+
+void clock_format_ns(char* buf, size_t size, uint64_t ns) {
+    uint32_t frac;
+    const char* unit = "ms";
+    uint64_t whole = div_u64(ns, 1000000, &frac);  // ms and leftover ns
+    if (whole >= 10000) {
+        unit = "s";
+        whole = div_u64(ns, 1000000000, &frac);
+        frac /= 1000000;
+    } else {
+        frac /= 1000;
+    }
+    char digits[21];
+    clock_format_u64(digits, whole);
+    const char* pad = frac < 10 ? "00" : frac < 100 ? "0" : "";
+    format(buf, size, "%s.%s%d %s", digits, pad, (int)frac, unit);
+}
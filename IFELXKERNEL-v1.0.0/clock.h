@@ -0,0 +1,19 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+#include <stddef.h>
+#include <stdint.h>
+
+// Nanosecond clock from the TSC, calibrated against the PIT at boot. Falls
+// back to PIT ticks when the CPU has no TSC.
+
+void clock_init(void);
+uint64_t clock_now(void);     // ns since clock_init
+uint64_t clock_cycles(void);  // raw TSC, 0 without one
+uint32_t clock_mhz(void);
+
+// Writes a duration as "12.345 ms" or "3.210 s"
+void clock_format_ns(char* buf, size_t size, uint64_t ns);
+// Decimal digits of an unsigned 64-bit value; buf needs 21 bytes
+void clock_format_u64(char* buf, uint64_t v);
+
+#endif // CLOCK_H
@@ -3,93 +3,31 @@
 #include "mini_string.h"
 #include <stdbool.h>
 #include "heap.h"
+#include "slab.h"
+#include "pmm.h"
+#include "arena.h"
+#include "raster.h"
+#include "timer.h"
+#include "clock.h"
+#include "shell.h"
 #include "keyboard.h"
+#include "intern.h"
+#include "diskfs.h"
+#include "bcache.h"
+#include "pci.h"
+#include "xvr.h"
 #include <stdarg.h>
 #include <stddef.h>
 
 // Constants for safety
 #define MAX_FILENAME 255
-#define MAX_CONTENT 32767
 #define MAX_INPUT_LINE 1024
-#define MAX_TOKENS 2000
-#define MAX_VARIABLES 200
 #define MAX_FUNCTIONS 100
-#define MAX_STACK_SIZE 1000
-#define MAX_BYTECODE 5000
 
 // Global variables
-txt_file_t* files_head = NULL;
-folder_t* folders_head = NULL;
-folder_t* current_folder = NULL;
-char current_path[1024] = "/";
+char current_path[VFS_PATH_MAX] = "/";
 
 // Compiler structures
-typedef enum {
-    TOKEN_NUMBER,
-    TOKEN_STRING,
-    TOKEN_IDENTIFIER,
-    TOKEN_PLUS,
-    TOKEN_MINUS,
-    TOKEN_MULTIPLY,
-    TOKEN_DIVIDE,
-    TOKEN_ASSIGN,
-    TOKEN_SEMICOLON,
-    TOKEN_LPAREN,
-    TOKEN_RPAREN,
-    TOKEN_LBRACE,
-    TOKEN_RBRACE,
-    TOKEN_IF,
-    TOKEN_WHILE,
-    TOKEN_FOR,
-    TOKEN_INT,
-    TOKEN_CHAR,
-    TOKEN_PRINTF,
-    TOKEN_RETURN,
-    TOKEN_MAIN,
-    TOKEN_EOF,
-    TOKEN_NEWLINE,
-    TOKEN_COMMA,
-    TOKEN_EQUALS,
-    TOKEN_LESS,
-    TOKEN_GREATER,
-    TOKEN_AND,
-    TOKEN_OR,
-    TOKEN_DEF,
-    TOKEN_PRINT,
-    TOKEN_INPUT,
-    TOKEN_COLON,
-    TOKEN_INDENT,
-    TOKEN_DEDENT,
-    TOKEN_INCLUDE,
-    TOKEN_VOID
-} TokenType;
-
-typedef struct {
-    TokenType type;
-    char value[256];
-    int int_value;
-    int line;
-} Token;
-
-typedef enum {
-    VAR_INT,
-    VAR_STRING,
-    VAR_CHAR,
-    VAR_FLOAT
-} VarType;
-
-typedef struct {
-    char name[64];
-    VarType type;
-    union {
-        int int_val;
-        char str_val[256];
-        char char_val;
-        float float_val;
-    } value;
-    bool is_global;
-} Variable;
-
 typedef struct {
     char name[64];
     int start_pos;
@@ -97,58 +35,89 @@ typedef struct {
     VarType return_type;
 } Function;
 
-// Bytecode instructions for XVR format
-typedef enum {
-    OP_LOAD_CONST,
-    OP_LOAD_VAR,
-    OP_STORE_VAR,
-    OP_ADD,
-    OP_SUB,
-    OP_MUL,
-    OP_DIV,
-    OP_PRINT,
-    OP_PRINTF,
-    OP_CALL,
-    OP_RETURN,
-    OP_JUMP,
-    OP_JUMP_IF_FALSE,
-    OP_COMPARE,
-    OP_HALT,
-    OP_INPUT,
-    OP_GRAPHICS_MODE,
-    OP_DRAW_PIXEL,
-    OP_DRAW_LINE,
-    OP_DRAW_RECT
-} OpCode;
-
+// Runtime structures. Each compile or run job gets its own Runtime whose
+// arrays are carved from a per-job arena sized to the program.
 typedef struct {
-    OpCode op;
-    int arg1;
-    int arg2;
-    char str_arg[256];
-} Instruction;
-
-// Runtime structures
-typedef struct {
-    Variable variables[MAX_VARIABLES];
+    Variable* variables;
     int var_count;
-    Function functions[MAX_FUNCTIONS];
+    int var_cap;
     int func_count;
-    int stack[MAX_STACK_SIZE];
+    int* stack;
     int stack_top;
-    Token tokens[MAX_TOKENS];
+    int stack_cap;
+    Token* tokens;
     int token_count;
+    int token_cap;
     int current_token;
     bool graphics_mode;
-    Instruction bytecode[MAX_BYTECODE];
+    Instruction* bytecode;
     int bytecode_count;
+    int bytecode_cap;
     int pc; // Program counter
-    int constants[MAX_VARIABLES];
+    int* constants;
     int const_count;
+    int const_cap;
+    arena_t arena;
 } Runtime;
 
-// Runtime structure is declared here
-Runtime runtime;
+// Runtime of the job currently compiling or executing
+static Runtime* runtime = NULL;
+
+static int clamp_cap(int n, int max) {
+    if (n < 1) return 1;
+    return n < max ? n : max;
+}
+
+// Builds a Runtime and all of its arrays in one arena. Capacities are clamped
+// to the old fixed limits so compiled images stay compatible.
+static Runtime* runtime_create(int tokens, int bytecode, int vars, int consts, int stack) {
+    tokens = clamp_cap(tokens, MAX_TOKENS);
+    bytecode = clamp_cap(bytecode, MAX_BYTECODE);
+    vars = clamp_cap(vars, MAX_VARIABLES);
+    consts = clamp_cap(consts, MAX_VARIABLES);
+    stack = clamp_cap(stack, MAX_STACK_SIZE);
+
+    size_t bytes = sizeof(Runtime) + tokens * sizeof(Token) + bytecode * sizeof(Instruction) +
+                   vars * sizeof(Variable) + (consts + stack) * sizeof(int) + 6 * 8;
+    arena_t arena;
+    if (!arena_init(&arena, bytes)) return NULL;
+
+    Runtime* rt = (Runtime*)arena_alloc(&arena, sizeof(Runtime));
+    memset(rt, 0, sizeof(*rt));
+    rt->tokens = (Token*)arena_alloc(&arena, tokens * sizeof(Token));
+    rt->token_cap = tokens;
+    rt->bytecode = (Instruction*)arena_alloc(&arena, bytecode * sizeof(Instruction));
+    rt->bytecode_cap = bytecode;
+    rt->variables = (Variable*)arena_alloc(&arena, vars * sizeof(Variable));
+    rt->var_cap = vars;
+    rt->constants = (int*)arena_alloc(&arena, consts * sizeof(int));
+    rt->const_cap = consts;
+    rt->stack = (int*)arena_alloc(&arena, stack * sizeof(int));
+    rt->stack_cap = stack;
+    rt->arena = arena;
+    return rt;
+}
+
+static void runtime_destroy(Runtime* rt) {
+    if (!rt) return;
+    if (runtime == rt) runtime = NULL;
+    arena_t arena = rt->arena;
+    arena_release(&arena);
+}
+
+// Token and operand text is per program, so it is copied into the job's
+// arena and freed with it instead of being interned. These copies are
+// compared by content, never by pointer.
+static const istr_t* job_text(Runtime* rt, const char* s, size_t len) {
+    if (len == 0) return istr_empty;
+    istr_t* t = (istr_t*)arena_alloc(&rt->arena, sizeof(istr_t) + len + 1);
+    if (!t) return NULL;
+    t->hash = intern_hash(s, len);
+    t->len = (uint32_t)len;
+    memcpy(t->str, s, len);
+    t->str[len] = '\0';
+    return t;
+}
 
 // Helper functions
 static int simple_snprintf(char* buffer, size_t size, const char* format, const char* str) {
@@ -220,9 +189,26 @@ static bool is_valid_name(const char* name) {
     }
     
     if (strlen(name) > MAX_FILENAME) return false;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) return false;
     return true;
 }
 
+// Like is_valid_name, but '/' separates components
+static bool is_valid_path(const char* path) {
+    if (!path || !*path) return false;
+    
+    const char* invalid_chars = "\\:*?\"<>|";
+    for (int i = 0; path[i]; i++) {
+        for (int j = 0; invalid_chars[j]; j++) {
+            if (path[i] == invalid_chars[j]) {
+                return false;
+            }
+        }
+    }
+    
+    return strlen(path) < VFS_PATH_MAX;
+}
+
 static void safe_string_copy(char* dest, const char* src, size_t dest_size) {
     if (!dest || !src || dest_size == 0) return;
     
@@ -233,48 +219,34 @@ static void safe_string_copy(char* dest, const char* src, size_t dest_size) {
     dest[i] = '\0';
 }
 
-static txt_file_t* find_file(const char* name) {
-    struct txt_file* current_files = current_folder ? current_folder->files : files_head;
-    
-    struct txt_file* f = current_files;
-    while (f) {
-        if (strcmp(f->name, name) == 0) {
-            return f;
-        }
-        f = f->next;
-    }
-    return NULL;
+// Resolves `path` to a regular file
+static fs_node_t* find_file(const char* path) {
+    fs_node_t* node = vfs_resolve(path);
+    return node && node->type == TYPE_FILE ? node : NULL;
 }
 
-static folder_t* find_folder(const char* name) {
-    struct folder* f = folders_head;
-    while (f) {
-        if (strcmp(f->name, name) == 0) {
-            return f;
-        }
-        f = f->next;
-    }
-    return NULL;
+// Finds the directory a new entry at `path` goes into and copies its name
+// to `leaf`; reports and returns NULL if it cannot be created there.
+static fs_node_t* prepare_create(const char* path, char* leaf, size_t leaf_size, const char* invalid) {
+    fs_node_t* dir = is_valid_path(path) ? vfs_resolve_parent(path, leaf, leaf_size) : NULL;
+    if (!dir) {
+        vga_puts(is_valid_path(path) ? "[X] Directory not found\n" : invalid);
+        return NULL;
+    }
+    if (!is_valid_name(leaf)) {
+        vga_puts(invalid);
+        return NULL;
+    }
+    fs_node_t* existing = vfs_lookup(dir, leaf);
+    if (existing) {
+        vga_puts(existing->type == TYPE_FILE ? "[X] File already exists\n" : "[X] Folder already exists\n");
+        return NULL;
+    }
+    return dir;
 }
 
 static void update_current_path(void) {
-    if (!current_folder) {
-        safe_string_copy(current_path, "/", sizeof(current_path));
-        return;
-    }
-    
-    char temp_path[512] = "/";
-    if (current_folder) {
-        safe_string_copy(temp_path, "/", sizeof(temp_path));
-        size_t len = strlen(temp_path);
-        safe_string_copy(temp_path + len, current_folder->name, sizeof(temp_path) - len);
-        len = strlen(temp_path);
-        if (len < sizeof(temp_path) - 1) {
-            temp_path[len] = '/';
-            temp_path[len + 1] = '\0';
-        }
-    }
-    safe_string_copy(current_path, temp_path, sizeof(current_path));
+    vfs_path(current_dir, current_path, sizeof(current_path));
 }
 
 // Lexer functions
@@ -296,99 +268,164 @@ void skip_whitespace(const char** str) {
     }
 }
 
-static TokenType get_keyword_type(const char* word) {
-    if (strcmp(word, "int") == 0) return TOKEN_INT;
-    if (strcmp(word, "char") == 0) return TOKEN_CHAR;
-    if (strcmp(word, "void") == 0) return TOKEN_VOID;
-    if (strcmp(word, "if") == 0) return TOKEN_IF;
-    if (strcmp(word, "while") == 0) return TOKEN_WHILE;
-    if (strcmp(word, "for") == 0) return TOKEN_FOR;
-    if (strcmp(word, "printf") == 0) return TOKEN_PRINTF;
-    if (strcmp(word, "return") == 0) return TOKEN_RETURN;
-    if (strcmp(word, "main") == 0) return TOKEN_MAIN;
-    if (strcmp(word, "def") == 0) return TOKEN_DEF;
-    if (strcmp(word, "print") == 0) return TOKEN_PRINT;
-    if (strcmp(word, "input") == 0) return TOKEN_INPUT;
-    if (strcmp(word, "#include") == 0) return TOKEN_INCLUDE;
+static const struct {
+    const char* word;
+    TokenType type;
+} keywords[] = {
+    { "int", TOKEN_INT },
+    { "char", TOKEN_CHAR },
+    { "void", TOKEN_VOID },
+    { "if", TOKEN_IF },
+    { "while", TOKEN_WHILE },
+    { "for", TOKEN_FOR },
+    { "printf", TOKEN_PRINTF },
+    { "return", TOKEN_RETURN },
+    { "main", TOKEN_MAIN },
+    { "def", TOKEN_DEF },
+    { "print", TOKEN_PRINT },
+    { "input", TOKEN_INPUT },
+    { "#include", TOKEN_INCLUDE },
+};
+
+// Keywords are interned once and kept, so a word is looked up in the
+// intern table without adding to it and matched by pointer
+static TokenType get_keyword_type(const char* word, size_t len) {
+    static const istr_t* names[sizeof(keywords) / sizeof(keywords[0])];
+    static bool ready = false;
+    if (!ready) {
+        ready = true;
+        for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+            names[i] = intern(keywords[i].word);
+            if (!names[i]) ready = false;
+        }
+    }
+    const istr_t* key = intern_find_n(word, len);
+    if (!key) return TOKEN_IDENTIFIER;
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+        if (names[i] == key) return keywords[i].type;
+    }
     return TOKEN_IDENTIFIER;
 }
 
-static int tokenize_c(const char* code, Token* tokens, int max_tokens) {
+// Buffered character stream over a file, so the tokenizer never needs the
+// source in one piece
+typedef struct {
+    fs_node_t* file;
+    size_t off;     // file offset of the next refill
+    size_t pos;
+    size_t len;
+    char buf[256];
+} SourceReader;
+
+static void source_open(SourceReader* r, fs_node_t* file) {
+    r->file = file;
+    r->off = 0;
+    r->pos = 0;
+    r->len = 0;
+}
+
+// Character `ahead` places past the current one, or '\0' past the end
+static char source_peek(SourceReader* r, size_t ahead) {
+    if (r->pos + ahead >= r->len) {
+        size_t keep = r->len - r->pos;
+        memmove(r->buf, r->buf + r->pos, keep);
+        size_t got = fs_read(r->file, r->off, r->buf + keep, sizeof(r->buf) - keep);
+        r->off += got;
+        r->len = keep + got;
+        r->pos = 0;
+        if (ahead >= r->len) return '\0';
+    }
+    return r->buf[r->pos + ahead];
+}
+
+static char source_next(SourceReader* r) {
+    char c = source_peek(r, 0);
+    if (c) r->pos++;
+    return c;
+}
+
+static void source_skip_whitespace(SourceReader* r) {
+    for (;;) {
+        char c = source_peek(r, 0);
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') return;
+        r->pos++;
+    }
+}
+
+// With tokens == NULL only counts, so a job can size its token array exactly.
+// Returns -1 if the job arena cannot hold a token's text.
+static int tokenize_c(SourceReader* src, Token* tokens, int max_tokens) {
     int token_count = 0;
-    const char* current = code;
     int line = 1;
+    Token scratch;
     
-    while (*current && token_count < max_tokens - 1) {
-        skip_whitespace(&current);
+    while (source_peek(src, 0) && token_count < max_tokens - 1) {
+        source_skip_whitespace(src);
         
-        if (*current == '\0') break;
+        if (source_peek(src, 0) == '\0') break;
         
-        Token* token = &tokens[token_count++];
+        Token* token = tokens ? &tokens[token_count] : &scratch;
+        token_count++;
         token->line = line;
+        char text[256];
+        int i = 0;
         
-        if (*current == '\n') {
+        if (source_peek(src, 0) == '\n') {
             token->type = TOKEN_NEWLINE;
-            token->value[0] = '\n';
-            token->value[1] = '\0';
-            current++;
+            text[i++] = '\n';
+            source_next(src);
             line++;
-        } else if (*current == '#') {
+        } else if (source_peek(src, 0) == '#') {
             // Handle preprocessor directives
             token->type = TOKEN_INCLUDE;
-            int i = 0;
-            while (*current && *current != '\n' && i < 255) {
-                token->value[i++] = *current++;
+            while (source_peek(src, 0) && source_peek(src, 0) != '\n' && i < 255) {
+                text[i++] = source_next(src);
             }
-            token->value[i] = '\0';
-        } else if (is_digit(*current)) {
+        } else if (is_digit(source_peek(src, 0))) {
             token->type = TOKEN_NUMBER;
-            int i = 0;
             int value = 0;
-            while (is_digit(*current) && i < 255) {
-                token->value[i++] = *current;
-                value = value * 10 + (*current - '0');
-                current++;
+            while (is_digit(source_peek(src, 0)) && i < 255) {
+                text[i++] = source_peek(src, 0);
+                value = value * 10 + (source_peek(src, 0) - '0');
+                source_next(src);
             }
-            token->value[i] = '\0';
             token->int_value = value;
-        } else if (is_alpha(*current)) {
-            int i = 0;
-            while (is_alnum(*current) && i < 255) {
-                token->value[i++] = *current++;
+        } else if (is_alpha(source_peek(src, 0))) {
+            while (is_alnum(source_peek(src, 0)) && i < 255) {
+                text[i++] = source_next(src);
             }
-            token->value[i] = '\0';
-            token->type = get_keyword_type(token->value);
-        } else if (*current == '"') {
+            token->type = TOKEN_IDENTIFIER;
+        } else if (source_peek(src, 0) == '"') {
             token->type = TOKEN_STRING;
-            current++; // Skip opening quote
-            int i = 0;
-            while (*current && *current != '"' && i < 255) {
-                if (*current == '\\' && *(current + 1) == 'n') {
-                    token->value[i++] = '\n';
-                    current += 2;
+            source_next(src); // Skip opening quote
+            while (source_peek(src, 0) && source_peek(src, 0) != '"' && i < 255) {
+                if (source_peek(src, 0) == '\\' && source_peek(src, 1) == 'n') {
+                    text[i++] = '\n';
+                    source_next(src);
+                    source_next(src);
                 } else {
-                    token->value[i++] = *current++;
+                    text[i++] = source_next(src);
                 }
             }
-            token->value[i] = '\0';
-            if (*current == '"') current++; // Skip closing quote
+            if (source_peek(src, 0) == '"') source_next(src); // Skip closing quote
         } else {
-            switch (*current) {
+            switch (source_peek(src, 0)) {
                 case '+': token->type = TOKEN_PLUS; break;
                 case '-': token->type = TOKEN_MINUS; break;
                 case '*': token->type = TOKEN_MULTIPLY; break;
                 case '/': 
-                    if (*(current + 1) == '/') {
+                    if (source_peek(src, 1) == '/') {
                         // Skip single line comment
-                        while (*current && *current != '\n') current++;
+                        while (source_peek(src, 0) && source_peek(src, 0) != '\n') source_next(src);
+                        token_count--;
                         continue;
                     }
                     token->type = TOKEN_DIVIDE; 
                     break;
                 case '=': 
-                    if (*(current + 1) == '=') {
+                    if (source_peek(src, 1) == '=') {
                         token->type = TOKEN_EQUALS;
-                        current++;
+                        source_next(src);
                     } else {
                         token->type = TOKEN_ASSIGN;
                     }
@@ -404,55 +441,66 @@ static int tokenize_c(const char* code, Token* tokens, int max_tokens) {
                 case ':': token->type = TOKEN_COLON; break;
                 default:
                     // Skip unknown characters
-                    current++;
+                    source_next(src);
                     token_count--; // Don't count this token
                     continue;
             }
-            token->value[0] = *current;
-            token->value[1] = '\0';
-            current++;
+            text[i++] = source_peek(src, 0);
+            source_next(src);
+        }
+        
+        if (tokens) {
+            token->value = job_text(runtime, text, i);
+            if (!token->value) return -1;
+            if (token->type == TOKEN_IDENTIFIER) token->type = get_keyword_type(text, i);
         }
     }
     
-    tokens[token_count].type = TOKEN_EOF;
+    if (tokens) tokens[token_count].type = TOKEN_EOF;
     return token_count;
 }
 
+// Sizes a compile job from an exact token count. Every instruction consumes
+// at least one token except the final OP_HALT, and every variable, constant
+// and stack slot comes from an instruction.
+static Runtime* runtime_for_source(fs_node_t* source) {
+    SourceReader reader;
+    source_open(&reader, source);
+    int count = tokenize_c(&reader, NULL, MAX_TOKENS);
+    return runtime_create(count + 1, count + 1, count + 1, count + 1, count + 1);
+}
+
 // Bytecode generation functions
-static void emit_instruction(OpCode op, int arg1, int arg2, const char* str_arg) {
-    if (runtime.bytecode_count >= MAX_BYTECODE) return;
+static void emit_instruction(OpCode op, int arg1, int arg2, const istr_t* str_arg) {
+    if (runtime->bytecode_count >= runtime->bytecode_cap) return;
     
-    Instruction* inst = &runtime.bytecode[runtime.bytecode_count++];
+    Instruction* inst = &runtime->bytecode[runtime->bytecode_count++];
     inst->op = op;
     inst->arg1 = arg1;
     inst->arg2 = arg2;
-    if (str_arg) {
-        safe_string_copy(inst->str_arg, str_arg, sizeof(inst->str_arg));
-    } else {
-        inst->str_arg[0] = '\0';
-    }
+    inst->str_arg = str_arg ? str_arg : istr_empty;
 }
 
 static int add_constant(int value) {
-    if (runtime.const_count >= MAX_VARIABLES) return -1;
-    runtime.constants[runtime.const_count] = value;
-    return runtime.const_count++;
+    if (runtime->const_count >= runtime->const_cap) return -1;
+    runtime->constants[runtime->const_count] = value;
+    return runtime->const_count++;
 }
 
 // Runtime functions
 static Variable* find_variable(const char* name) {
-    for (int i = 0; i < runtime.var_count; i++) {
-        if (strcmp(runtime.variables[i].name, name) == 0) {
-            return &runtime.variables[i];
+    for (int i = 0; i < runtime->var_count; i++) {
+        if (strcmp(runtime->variables[i].name, name) == 0) {
+            return &runtime->variables[i];
         }
     }
     return NULL;
 }
 
 static Variable* create_variable(const char* name, VarType type) {
-    if (runtime.var_count >= MAX_VARIABLES) return NULL;
+    if (runtime->var_count >= runtime->var_cap) return NULL;
     
-    Variable* var = &runtime.variables[runtime.var_count++];
+    Variable* var = &runtime->variables[runtime->var_count++];
     safe_string_copy(var->name, name, sizeof(var->name));
     var->type = type;
     var->is_global = true;
@@ -478,25 +526,25 @@ static Variable* create_variable(const char* name, VarType type) {
 
 // C Compiler functions
 static bool compile_c_expression(void) {
-    if (runtime.current_token >= runtime.token_count) return false;
+    if (runtime->current_token >= runtime->token_count) return false;
     
-    Token* token = &runtime.tokens[runtime.current_token];
+    Token* token = &runtime->tokens[runtime->current_token];
     
     if (token->type == TOKEN_NUMBER) {
         int const_idx = add_constant(token->int_value);
         emit_instruction(OP_LOAD_CONST, const_idx, 0, NULL);
-        runtime.current_token++;
+        runtime->current_token++;
         return true;
     } else if (token->type == TOKEN_IDENTIFIER) {
         emit_instruction(OP_LOAD_VAR, 0, 0, token->value);
-        runtime.current_token++;
+        runtime->current_token++;
         
         // Handle binary operations
-        if (runtime.current_token < runtime.token_count) {
-            Token* op_token = &runtime.tokens[runtime.current_token];
+        if (runtime->current_token < runtime->token_count) {
+            Token* op_token = &runtime->tokens[runtime->current_token];
             if (op_token->type == TOKEN_PLUS || op_token->type == TOKEN_MINUS ||
                 op_token->type == TOKEN_MULTIPLY || op_token->type == TOKEN_DIVIDE) {
-                runtime.current_token++;
+                runtime->current_token++;
                 if (compile_c_expression()) {
                     switch (op_token->type) {
                         case TOKEN_PLUS: emit_instruction(OP_ADD, 0, 0, NULL); break;
@@ -511,7 +559,7 @@ static bool compile_c_expression(void) {
         return true;
     } else if (token->type == TOKEN_STRING) {
         emit_instruction(OP_LOAD_CONST, 0, 0, token->value);
-        runtime.current_token++;
+        runtime->current_token++;
         return true;
     }
     
@@ -519,28 +567,28 @@ static bool compile_c_expression(void) {
 }
 
 static bool compile_c_statement(void) {
-    if (runtime.current_token >= runtime.token_count) return false;
+    if (runtime->current_token >= runtime->token_count) return false;
     
-    Token* token = &runtime.tokens[runtime.current_token];
+    Token* token = &runtime->tokens[runtime->current_token];
     
     switch (token->type) {
         case TOKEN_INT:
         case TOKEN_CHAR:
             // Variable declaration
-            runtime.current_token++;
-            if (runtime.current_token < runtime.token_count && 
-                runtime.tokens[runtime.current_token].type == TOKEN_IDENTIFIER) {
+            runtime->current_token++;
+            if (runtime->current_token < runtime->token_count && 
+                runtime->tokens[runtime->current_token].type == TOKEN_IDENTIFIER) {
                 VarType var_type = (token->type == TOKEN_INT) ? VAR_INT : VAR_CHAR;
-                create_variable(runtime.tokens[runtime.current_token].value, var_type);
-                runtime.current_token++;
+                const istr_t* var_name = runtime->tokens[runtime->current_token].value;
+                create_variable(var_name->str, var_type);
+                runtime->current_token++;
                 
                 // Check for initialization
-                if (runtime.current_token < runtime.token_count && 
-                    runtime.tokens[runtime.current_token].type == TOKEN_ASSIGN) {
-                    runtime.current_token++;
+                if (runtime->current_token < runtime->token_count && 
+                    runtime->tokens[runtime->current_token].type == TOKEN_ASSIGN) {
+                    runtime->current_token++;
                     if (compile_c_expression()) {
-                        emit_instruction(OP_STORE_VAR, 0, 0, 
-                                       runtime.variables[runtime.var_count - 1].name);
+                        emit_instruction(OP_STORE_VAR, 0, 0, var_name);
                     }
                 }
             }
@@ -549,13 +597,12 @@ static bool compile_c_statement(void) {
         case TOKEN_IDENTIFIER:
             // Assignment or function call
             {
-                char var_name[256];
-                safe_string_copy(var_name, token->value, sizeof(var_name));
-                runtime.current_token++;
+                const istr_t* var_name = token->value;
+                runtime->current_token++;
                 
-                if (runtime.current_token < runtime.token_count && 
-                    runtime.tokens[runtime.current_token].type == TOKEN_ASSIGN) {
-                    runtime.current_token++;
+                if (runtime->current_token < runtime->token_count && 
+                    runtime->tokens[runtime->current_token].type == TOKEN_ASSIGN) {
+                    runtime->current_token++;
                     if (compile_c_expression()) {
                         emit_instruction(OP_STORE_VAR, 0, 0, var_name);
                     }
@@ -564,100 +611,98 @@ static bool compile_c_statement(void) {
             break;
             
         case TOKEN_PRINTF:
-            runtime.current_token++;
-            if (runtime.current_token < runtime.token_count && 
-                runtime.tokens[runtime.current_token].type == TOKEN_LPAREN) {
-                runtime.current_token++;
+            runtime->current_token++;
+            if (runtime->current_token < runtime->token_count && 
+                runtime->tokens[runtime->current_token].type == TOKEN_LPAREN) {
+                runtime->current_token++;
                 
                 // Compile printf arguments
                 int arg_count = 0;
-                while (runtime.current_token < runtime.token_count && 
-                       runtime.tokens[runtime.current_token].type != TOKEN_RPAREN) {
+                while (runtime->current_token < runtime->token_count && 
+                       runtime->tokens[runtime->current_token].type != TOKEN_RPAREN) {
                     if (compile_c_expression()) {
                         arg_count++;
                     }
-                    if (runtime.current_token < runtime.token_count && 
-                        runtime.tokens[runtime.current_token].type == TOKEN_COMMA) {
-                        runtime.current_token++;
+                    if (runtime->current_token < runtime->token_count && 
+                        runtime->tokens[runtime->current_token].type == TOKEN_COMMA) {
+                        runtime->current_token++;
                     }
                 }
                 
                 emit_instruction(OP_PRINTF, arg_count, 0, NULL);
                 
-                if (runtime.current_token < runtime.token_count) {
-                    runtime.current_token++; // Skip )
+                if (runtime->current_token < runtime->token_count) {
+                    runtime->current_token++; // Skip )
                 }
             }
             break;
             
         case TOKEN_RETURN:
-            runtime.current_token++;
+            runtime->current_token++;
             if (compile_c_expression()) {
                 emit_instruction(OP_RETURN, 0, 0, NULL);
             }
             break;
             
         default:
-            runtime.current_token++;
+            runtime->current_token++;
             break;
     }
     
     // Skip semicolon
-    if (runtime.current_token < runtime.token_count && 
-        runtime.tokens[runtime.current_token].type == TOKEN_SEMICOLON) {
-        runtime.current_token++;
+    if (runtime->current_token < runtime->token_count && 
+        runtime->tokens[runtime->current_token].type == TOKEN_SEMICOLON) {
+        runtime->current_token++;
     }
     
     return true;
 }
 
-static bool compile_c_program(const char* source_code) {
-    // Initialize runtime
-    runtime.var_count = 0;
-    runtime.func_count = 0;
-    runtime.bytecode_count = 0;
-    runtime.const_count = 0;
-    runtime.current_token = 0;
+static bool compile_c_program(fs_node_t* source) {
+    if (!runtime) return false;
     
     // Tokenize
-    runtime.token_count = tokenize_c(source_code, runtime.tokens, MAX_TOKENS);
+    SourceReader reader;
+    source_open(&reader, source);
+    runtime->token_count = tokenize_c(&reader, runtime->tokens, runtime->token_cap);
+    if (runtime->token_count < 0) return false;
     
     // Compile statements
-    while (runtime.current_token < runtime.token_count) {
-        Token* token = &runtime.tokens[runtime.current_token];
+    while (runtime->current_token < runtime->token_count) {
+        Token* token = &runtime->tokens[runtime->current_token];
         
         if (token->type == TOKEN_EOF) break;
         if (token->type == TOKEN_NEWLINE || token->type == TOKEN_INCLUDE) {
-            runtime.current_token++;
+            runtime->current_token++;
             continue;
         }
         
         // Skip function definitions for now (main function handling)
-        if (token->type == TOKEN_INT && runtime.current_token + 1 < runtime.token_count &&
-            runtime.tokens[runtime.current_token + 1].type == TOKEN_MAIN) {
-            runtime.current_token += 2; // Skip "int main"
+        if (token->type == TOKEN_INT && runtime->current_token + 1 < runtime->token_count &&
+            runtime->tokens[runtime->current_token + 1].type == TOKEN_MAIN) {
+            runtime->current_token += 2; // Skip "int main"
             
             // Skip function signature
-            while (runtime.current_token < runtime.token_count && 
-                   runtime.tokens[runtime.current_token].type != TOKEN_LBRACE) {
-                runtime.current_token++;
+            while (runtime->current_token < runtime->token_count && 
+                   runtime->tokens[runtime->current_token].type != TOKEN_LBRACE) {
+                runtime->current_token++;
             }
             
-            if (runtime.current_token < runtime.token_count) {
-                runtime.current_token++; // Skip {
+            if (runtime->current_token < runtime->token_count) {
+                runtime->current_token++; // Skip {
             }
             
             // Compile function body
             int brace_count = 1;
-            while (runtime.current_token < runtime.token_count && brace_count > 0) {
-                Token* current = &runtime.tokens[runtime.current_token];
+            while (runtime->current_token < runtime->token_count && brace_count > 0) {
+                Token* current = &runtime->tokens[runtime->current_token];
                 
                 if (current->type == TOKEN_LBRACE) {
                     brace_count++;
-                    runtime.current_token++;
+                    runtime->current_token++;
                 } else if (current->type == TOKEN_RBRACE) {
                     brace_count--;
-                    runtime.current_token++;
+                    runtime->current_token++;
                 } else {
                     compile_c_statement();
                 }
@@ -672,69 +717,66 @@ static bool compile_c_program(const char* source_code) {
 }
 
 // Python Compiler functions
-static bool compile_python_program(const char* source_code) {
-    // Initialize runtime
-    runtime.var_count = 0;
-    runtime.func_count = 0;
-    runtime.bytecode_count = 0;
-    runtime.const_count = 0;
-    runtime.current_token = 0;
+static bool compile_python_program(fs_node_t* source) {
+    if (!runtime) return false;
     
     // Simple Python tokenization and compilation
-    runtime.token_count = tokenize_c(source_code, runtime.tokens, MAX_TOKENS);
+    SourceReader reader;
+    source_open(&reader, source);
+    runtime->token_count = tokenize_c(&reader, runtime->tokens, runtime->token_cap);
+    if (runtime->token_count < 0) return false;
     
-    while (runtime.current_token < runtime.token_count) {
-        Token* token = &runtime.tokens[runtime.current_token];
+    while (runtime->current_token < runtime->token_count) {
+        Token* token = &runtime->tokens[runtime->current_token];
         
         if (token->type == TOKEN_EOF) break;
         if (token->type == TOKEN_NEWLINE) {
-            runtime.current_token++;
+            runtime->current_token++;
             continue;  
         }
         
         if (token->type == TOKEN_PRINT) {
-            runtime.current_token++;
-            if (runtime.current_token < runtime.token_count && 
-                runtime.tokens[runtime.current_token].type == TOKEN_LPAREN) {
-                runtime.current_token++;
+            runtime->current_token++;
+            if (runtime->current_token < runtime->token_count && 
+                runtime->tokens[runtime->current_token].type == TOKEN_LPAREN) {
+                runtime->current_token++;
                 
                 int arg_count = 0;
-                while (runtime.current_token < runtime.token_count && 
-                       runtime.tokens[runtime.current_token].type != TOKEN_RPAREN) {
+                while (runtime->current_token < runtime->token_count && 
+                       runtime->tokens[runtime->current_token].type != TOKEN_RPAREN) {
                     if (compile_c_expression()) {
                         arg_count++;
                     }
-                    if (runtime.current_token < runtime.token_count && 
-                        runtime.tokens[runtime.current_token].type == TOKEN_COMMA) {
-                        runtime.current_token++;
+                    if (runtime->current_token < runtime->token_count && 
+                        runtime->tokens[runtime->current_token].type == TOKEN_COMMA) {
+                        runtime->current_token++;
                     }
                 }
                 
                 emit_instruction(OP_PRINT, arg_count, 0, NULL);
                 
-                if (runtime.current_token < runtime.token_count) {
-                    runtime.current_token++; // Skip )
+                if (runtime->current_token < runtime->token_count) {
+                    runtime->current_token++; // Skip )
                 }
             }
         } else if (token->type == TOKEN_IDENTIFIER) {
             // Variable assignment
-            char var_name[256];
-            safe_string_copy(var_name, token->value, sizeof(var_name));
-            runtime.current_token++;
+            const istr_t* var_name = token->value;
+            runtime->current_token++;
             
-            if (runtime.current_token < runtime.token_count && 
-                runtime.tokens[runtime.current_token].type == TOKEN_ASSIGN) {
-                runtime.current_token++;
+            if (runtime->current_token < runtime->token_count && 
+                runtime->tokens[runtime->current_token].type == TOKEN_ASSIGN) {
+                runtime->current_token++;
                 if (compile_c_expression()) {
                     // Create variable if it doesn't exist
-                    if (!find_variable(var_name)) {
-                        create_variable(var_name, VAR_INT);
+                    if (!find_variable(var_name->str)) {
+                        create_variable(var_name->str, VAR_INT);
                     }
                     emit_instruction(OP_STORE_VAR, 0, 0, var_name);
                 }
             }
         } else {
-            runtime.current_token++;
+            runtime->current_token++;
         }
     }
     
@@ -742,129 +784,173 @@ static bool compile_python_program(const char* source_code) {
     return true;
 }
 
+// Program output goes through vga_emit and is flushed once per instruction,
+// not once per character
+static void vm_emit_str(const char* s) {
+    while (*s) vga_emit(*s++);
+}
+
+static void vm_emit_int(int n) {
+    char buf[12];
+    int len = 0;
+    unsigned int u = n < 0 ? 0u - (unsigned int)n : (unsigned int)n;
+    do {
+        buf[len++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (n < 0) vga_emit('-');
+    while (len) vga_emit(buf[--len]);
+}
+
 // XVR Virtual Machine
 static void execute_xvr_program(void) {
-    runtime.pc = 0;
-    runtime.stack_top = 0;
+    runtime->pc = 0;
+    runtime->stack_top = 0;
     
-    while (runtime.pc < runtime.bytecode_count) {
-        Instruction* inst = &runtime.bytecode[runtime.pc];
+    while (runtime->pc < runtime->bytecode_count) {
+        Instruction* inst = &runtime->bytecode[runtime->pc];
         
         switch (inst->op) {
             case OP_LOAD_CONST:
-                if (inst->str_arg[0]) {
+                if (inst->str_arg->len) {
                     // String constant
-                    vga_puts(inst->str_arg);
+                    vm_emit_str(inst->str_arg->str);
+                    vga_flush();
                 } else {
                     // Integer constant
-                    if (runtime.stack_top < MAX_STACK_SIZE) {
-                        runtime.stack[runtime.stack_top++] = runtime.constants[inst->arg1];
+                    if (runtime->stack_top < runtime->stack_cap &&
+                        inst->arg1 >= 0 && inst->arg1 < runtime->const_count) {
+                        runtime->stack[runtime->stack_top++] = runtime->constants[inst->arg1];
                     }
                 }
                 break;
                 
             case OP_LOAD_VAR:
                 {
-                    Variable* var = find_variable(inst->str_arg);
-                    if (var && runtime.stack_top < MAX_STACK_SIZE) {
-                        runtime.stack[runtime.stack_top++] = var->value.int_val;
+                    Variable* var = find_variable(inst->str_arg->str);
+                    if (var && runtime->stack_top < runtime->stack_cap) {
+                        runtime->stack[runtime->stack_top++] = var->value.int_val;
                     }
                 }
                 break;
                 
             case OP_STORE_VAR:
-                if (runtime.stack_top > 0) {
-                    Variable* var = find_variable(inst->str_arg);
+                if (runtime->stack_top > 0) {
+                    Variable* var = find_variable(inst->str_arg->str);
                     if (!var) {
-                        var = create_variable(inst->str_arg, VAR_INT);
+                        var = create_variable(inst->str_arg->str, VAR_INT);
                     }
                     if (var) {
-                        var->value.int_val = runtime.stack[--runtime.stack_top];
+                        var->value.int_val = runtime->stack[--runtime->stack_top];
                     }
                 }
                 break;
                 
             case OP_ADD:
-                if (runtime.stack_top >= 2) {
-                    int b = runtime.stack[--runtime.stack_top];
-                    int a = runtime.stack[--runtime.stack_top];
-                    runtime.stack[runtime.stack_top++] = a + b;
+                if (runtime->stack_top >= 2) {
+                    int b = runtime->stack[--runtime->stack_top];
+                    int a = runtime->stack[--runtime->stack_top];
+                    runtime->stack[runtime->stack_top++] = a + b;
                 }
                 break;
                 
             case OP_SUB:
-                if (runtime.stack_top >= 2) {
-                    int b = runtime.stack[--runtime.stack_top];
-                    int a = runtime.stack[--runtime.stack_top];
-                    runtime.stack[runtime.stack_top++] = a - b;
+                if (runtime->stack_top >= 2) {
+                    int b = runtime->stack[--runtime->stack_top];
+                    int a = runtime->stack[--runtime->stack_top];
+                    runtime->stack[runtime->stack_top++] = a - b;
                 }
                 break;
                 
             case OP_MUL:
-                if (runtime.stack_top >= 2) {
-                    int b = runtime.stack[--runtime.stack_top];
-                    int a = runtime.stack[--runtime.stack_top];
-                    runtime.stack[runtime.stack_top++] = a * b;
+                if (runtime->stack_top >= 2) {
+                    int b = runtime->stack[--runtime->stack_top];
+                    int a = runtime->stack[--runtime->stack_top];
+                    runtime->stack[runtime->stack_top++] = a * b;
                 }
                 break;
                 
             case OP_DIV:
-                if (runtime.stack_top >= 2) {
-                    int b = runtime.stack[--runtime.stack_top];
-                    int a = runtime.stack[--runtime.stack_top];
+                if (runtime->stack_top >= 2) {
+                    int b = runtime->stack[--runtime->stack_top];
+                    int a = runtime->stack[--runtime->stack_top];
                     if (b != 0) {
-                        runtime.stack[runtime.stack_top++] = a / b;
+                        runtime->stack[runtime->stack_top++] = a / b;
                     } else {
-                        runtime.stack[runtime.stack_top++] = 0;
+                        runtime->stack[runtime->stack_top++] = 0;
                     }
                 }
                 break;
                 
             case OP_PRINT:
-                if (runtime.stack_top > 0) {
-                    int value = runtime.stack[--runtime.stack_top];
-                    vga_printf("%d\n", value);
+                if (runtime->stack_top > 0) {
+                    int value = runtime->stack[--runtime->stack_top];
+                    vm_emit_int(value);
+                    vga_emit('\n');
+                    vga_flush();
                 }
                 break;
                 
             case OP_PRINTF:
                 // Handle printf with format string
-                if (inst->str_arg[0]) {
-                    char* format = inst->str_arg;
-                    char* p = format;
+                if (inst->str_arg->len) {
+                    const char* p = inst->str_arg->str;
                     while (*p) {
-                        if (*p == '%' && *(p + 1) == 'd' && runtime.stack_top > 0) {
-                            int value = runtime.stack[--runtime.stack_top];
-                            vga_printf("%d", value);
+                        if (*p == '%' && *(p + 1) == 'd' && runtime->stack_top > 0) {
+                            int value = runtime->stack[--runtime->stack_top];
+                            vm_emit_int(value);
                             p += 2;
                         } else if (*p == '\\' && *(p + 1) == 'n') {
-                            vga_putc('\n');
+                            vga_emit('\n');
                             p += 2;
                         } else {
-                            vga_putc(*p);
+                            vga_emit(*p);
                             p++;
                         }
                     }
-                } else if (runtime.stack_top > 0) {
-                    int value = runtime.stack[--runtime.stack_top];
-                    vga_printf("%d", value);
+                } else if (runtime->stack_top > 0) {
+                    int value = runtime->stack[--runtime->stack_top];
+                    vm_emit_int(value);
                 }
+                vga_flush();
                 break;
                 
             case OP_GRAPHICS_MODE:
-                runtime.graphics_mode = true;
+                runtime->graphics_mode = true;
                 vga_init_graphics();
                 break;
                 
             case OP_DRAW_PIXEL:
-                if (runtime.stack_top >= 3) {
-                    int color = runtime.stack[--runtime.stack_top];
-                    int y = runtime.stack[--runtime.stack_top];
-                    int x = runtime.stack[--runtime.stack_top];
+                if (runtime->stack_top >= 3) {
+                    int color = runtime->stack[--runtime->stack_top];
+                    int y = runtime->stack[--runtime->stack_top];
+                    int x = runtime->stack[--runtime->stack_top];
                     // Call graphics function to draw pixel
                     vga_set_pixel(x, y, color);
                 }
                 break;
+
+            case OP_DRAW_LINE:
+                if (runtime->stack_top >= 5) {
+                    int color = runtime->stack[--runtime->stack_top];
+                    int y1 = runtime->stack[--runtime->stack_top];
+                    int x1 = runtime->stack[--runtime->stack_top];
+                    int y0 = runtime->stack[--runtime->stack_top];
+                    int x0 = runtime->stack[--runtime->stack_top];
+                    raster_line(x0, y0, x1, y1, color);
+                }
+                break;
+
+            case OP_DRAW_RECT:
+                if (runtime->stack_top >= 5) {
+                    int color = runtime->stack[--runtime->stack_top];
+                    int h = runtime->stack[--runtime->stack_top];
+                    int w = runtime->stack[--runtime->stack_top];
+                    int y = runtime->stack[--runtime->stack_top];
+                    int x = runtime->stack[--runtime->stack_top];
+                    raster_fill_rect(x, y, w, h, color);
+                }
+                break;
                 
             case OP_HALT:
                 return;
@@ -873,152 +959,162 @@ static void execute_xvr_program(void) {
                 break;
         }
         
-        runtime.pc++;
+        runtime->pc++;
     }
 }
 
+// Shows the back buffer until ESC is pressed, then returns to text mode.
+// Nothing draws after this point, so one present is enough.
+static void graphics_until_esc(void) {
+    vga_present();
+    keyboard_wait_esc();
+    vga_init_text();
+}
+
 // Create XVR executable file
 static bool create_xvr_file(const char* name) {
-    char xvr_name[300];
+    char xvr_name[VFS_PATH_MAX + 8];
     snprintf(xvr_name, sizeof(xvr_name), "%s.xvr", name);
     
-    // Create executable file with bytecode
-    struct txt_file* xvr_file = (struct txt_file*)my_malloc(sizeof(struct txt_file));
-    if (!xvr_file) {
-        return false;
+    // Rebuilding replaces the existing image in place
+    fs_node_t* xvr_file = find_file(xvr_name);
+    bool fresh = !xvr_file;
+    if (fresh) {
+        char leaf[VFS_NAME_MAX + 1];
+        fs_node_t* dir = vfs_resolve_parent(xvr_name, leaf, sizeof(leaf));
+        if (!dir) {
+            return false;
+        }
+        xvr_file = vfs_create(dir, leaf, TYPE_FILE);
+        if (!xvr_file) {
+            return false;
+        }
     }
-    
-    safe_string_copy(xvr_file->name, xvr_name, sizeof(xvr_file->name));
+    // Empty now, so an existing file (from disk or the boot ramdisk) can
+    // switch its chunks over to the image tag too
+    fs_truncate(xvr_file, 0);
+    xvr_file->data.file.tag = HEAP_TAG_XVR;
     
     // Serialize bytecode to content
-    size_t content_size = sizeof(int) + runtime.bytecode_count * sizeof(Instruction) + 
-                         sizeof(int) + runtime.var_count * sizeof(Variable) +
-                         sizeof(int) + runtime.const_count * sizeof(int);
+    XvrHeader header = { runtime->bytecode_count, runtime->var_count, runtime->const_count };
+    bool ok = fs_append(xvr_file, &header, sizeof(header));
     
-    char* content = (char*)my_malloc(content_size);
-    if (!content) {
-        my_free(xvr_file);
-        return false;
+    for (int i = 0; ok && i < runtime->bytecode_count; i++) {
+        const Instruction* inst = &runtime->bytecode[i];
+        XvrInstruction rec = { inst->op, inst->arg1, inst->arg2, (int)inst->str_arg->len };
+        static const char pad[4];
+        ok = fs_append(xvr_file, &rec, sizeof(rec)) &&
+             fs_append(xvr_file, inst->str_arg->str, inst->str_arg->len) &&
+             fs_append(xvr_file, pad, XVR_STR_SPACE(inst->str_arg->len) - inst->str_arg->len);
     }
     
-    // Write bytecode header
-    char* ptr = content;
-    *((int*)ptr) = runtime.bytecode_count;
-    ptr += sizeof(int);
-    
-    // Write bytecode instructions
-    for (int i = 0; i < runtime.bytecode_count; i++) {
-        *((Instruction*)ptr) = runtime.bytecode[i];
-        ptr += sizeof(Instruction);
-    }
+    ok = ok && fs_append(xvr_file, runtime->variables, runtime->var_count * sizeof(Variable));
+    ok = ok && fs_append(xvr_file, runtime->constants, runtime->const_count * sizeof(int));
     
-    // Write variable count
-    *((int*)ptr) = runtime.var_count;
-    ptr += sizeof(int);
-    
-    // Write variables
-    for (int i = 0; i < runtime.var_count; i++) {
-        *((Variable*)ptr) = runtime.variables[i];
-        ptr += sizeof(Variable);
-    }
-    
-    // Write constants count
-    *((int*)ptr) = runtime.const_count;
-    ptr += sizeof(int);
-    
-    // Write constants
-    for (int i = 0; i < runtime.const_count; i++) {
-        *((int*)ptr) = runtime.constants[i];
-        ptr += sizeof(int);
-    }
-    
-    xvr_file->content = content;
-    xvr_file->content_size = content_size;
-    xvr_file->next = NULL;
-    
-    // Add to file system
-    if (current_folder) {
-        xvr_file->next = current_folder->files;
-        current_folder->files = xvr_file;
-    } else {
-        xvr_file->next = files_head;
-        files_head = xvr_file;
+    if (!ok) {
+        if (fresh) vfs_unlink(xvr_file);
+        else fs_truncate(xvr_file, 0);
+        return false;
     }
-    
     return true;
 }
 
-// Load XVR executable file
+// Load XVR executable file into a new runtime sized from its header counts
 static bool load_xvr_file(const char* name) {
-    char xvr_name[300];
+    char xvr_name[VFS_PATH_MAX + 8];
     snprintf(xvr_name, sizeof(xvr_name), "%s.xvr", name);
     
-    struct txt_file* xvr_file = find_file(xvr_name);
-    if (!xvr_file || !xvr_file->content) {
+    fs_node_t* xvr_file = find_file(xvr_name);
+    XvrHeader header;
+    if (!xvr_file || fs_read(xvr_file, 0, &header, sizeof(header)) != sizeof(header)) {
         return false;
     }
-    
-    // Deserialize bytecode from content
-    char* ptr = xvr_file->content;
-    
-    // Read bytecode count
-    runtime.bytecode_count = *((int*)ptr);
-    ptr += sizeof(int);
-    
-    // Read bytecode instructions
-    for (int i = 0; i < runtime.bytecode_count && i < MAX_BYTECODE; i++) {
-        runtime.bytecode[i] = *((Instruction*)ptr);
-        ptr += sizeof(Instruction);
+    // Every section must fit in what is left of the file; this also keeps
+    // the counts small enough that the sums below cannot overflow
+    uint64_t rest = xvr_file->data.file.size - sizeof(header);
+    if (header.bytecode_count < 0 || header.var_count < 0 || header.const_count < 0 ||
+        (uint64_t)header.bytecode_count * sizeof(XvrInstruction) +
+        (uint64_t)header.var_count * sizeof(Variable) +
+        (uint64_t)header.const_count * sizeof(int) > rest) {
+        vga_puts("[X] Corrupt executable header\n");
+        return false;
     }
     
-    // Read variable count
-    runtime.var_count = *((int*)ptr);
-    ptr += sizeof(int);
+    // Stored variables plus any the program creates while running
+    runtime = runtime_create(0, header.bytecode_count, header.var_count + header.bytecode_count,
+                             header.const_count, header.bytecode_count + 1);
+    if (!runtime) {
+        return false;
+    }
     
-    // Read variables
-    for (int i = 0; i < runtime.var_count && i < MAX_VARIABLES; i++) {
-        runtime.variables[i] = *((Variable*)ptr);
-        ptr += sizeof(Variable);
+    // Records are streamed in order; every section is read even if it is
+    // longer than the runtime can hold, so the next one starts in the right place
+    size_t off = sizeof(header);
+    for (int i = 0; i < header.bytecode_count; i++) {
+        XvrInstruction rec;
+        char str[256];
+        if (fs_read(xvr_file, off, &rec, sizeof(rec)) != sizeof(rec) ||
+            rec.str_len < 0 || rec.str_len >= (int)sizeof(str)) {
+            runtime_destroy(runtime);
+            return false;
+        }
+        off += sizeof(rec);
+        if (fs_read(xvr_file, off, str, rec.str_len) != (size_t)rec.str_len) {
+            runtime_destroy(runtime);
+            return false;
+        }
+        off +=XVR_STR_SPACE(rec.str_len);
+        if (i >= runtime->bytecode_cap) continue;
+        
+        Instruction* inst = &runtime->bytecode[runtime->bytecode_count];
+        inst->op = (OpCode)rec.op;
+        inst->arg1 = rec.arg1;
+        inst->arg2 = rec.arg2;
+        inst->str_arg = job_text(runtime, str, rec.str_len);
+        if (!inst->str_arg) {
+            runtime_destroy(runtime);
+            return false;
+        }
+        runtime->bytecode_count++;
     }
     
-    // Read constants count
-    runtime.const_count = *((int*)ptr);
-    ptr += sizeof(int);
+    size_t vars = (size_t)header.var_count < (size_t)runtime->var_cap
+                ? (size_t)header.var_count : (size_t)runtime->var_cap;
+    runtime->var_count = (int)(fs_read(xvr_file, off, runtime->variables, vars * sizeof(Variable)) /
+                               sizeof(Variable));
+    off += (size_t)header.var_count * sizeof(Variable);
     
-    // Read constants
-    for (int i = 0; i < runtime.const_count && i < MAX_VARIABLES; i++) {
-        runtime.constants[i] = *((int*)ptr);
-        ptr += sizeof(int);
-    }
+    size_t consts = (size_t)header.const_count < (size_t)runtime->const_cap
+                  ? (size_t)header.const_count : (size_t)runtime->const_cap;
+    runtime->const_count = (int)(fs_read(xvr_file, off, runtime->constants, consts * sizeof(int)) /
+                                 sizeof(int));
     
     return true;
 }
 
 // File system functions
 void list_files_and_folders(void) {
-    struct txt_file* current_files = current_folder ? current_folder->files : files_head;
+    fs_node_t* first = current_dir->data.folder.children;
     
     vga_puts("Files:\n");
-    struct txt_file* f = current_files;
     bool found_files = false;
-    while (f) {
-        vga_printf("- %s\n", f->name);
-        f = f->next;
-        found_files = true;
+    for (fs_node_t* n = first; n; n = n->next) {
+        if (n->type == TYPE_FILE) {
+            vga_printf("- %s\n", n->name->str);
+            found_files = true;
+        }
     }
     if (!found_files) {
         vga_puts("(No files)\n");
     }
     
     vga_puts("\nFolders:\n");
-    struct folder* dir = folders_head;
     bool found_folders = false;
-    while (dir) {
-        if (!current_folder || dir->parent == current_folder) {
-            vga_printf("- %s/\n", dir->name);
+    for (fs_node_t* n = first; n; n = n->next) {
+        if (n->type == TYPE_FOLDER) {
+            vga_printf("- %s/\n", n->name->str);
             found_folders = true;
         }
-        dir = dir->next;
     }
     if (!found_folders) {
         vga_puts("(No folders)\n");
@@ -1035,27 +1131,7 @@ void change_directory(const char* name) {
         return;
     }
     
-    if (strcmp(name, "..") == 0) {
-        if (current_folder && current_folder->parent) {
-            current_folder = current_folder->parent;
-        } else {
-            current_folder = NULL;
-        }
-        update_current_path();
-        vga_printf("Changed to directory: %s\n", current_path);
-        return;
-    }
-    
-    if (strcmp(name, "/") == 0) {
-        current_folder = NULL;
-        update_current_path();
-        vga_printf("Changed to directory: %s\n", current_path);
-        return;
-    }
-    
-    struct folder* target = find_folder(name);
-    if (target && (!current_folder || target->parent == current_folder)) {
-        current_folder = target;
+    if (is_valid_path(name) && vfs_chdir(name)) {
         update_current_path();
         vga_printf("Changed to directory: %s\n", current_path);
     } else {
@@ -1063,85 +1139,43 @@ void change_directory(const char* name) {
     }
 }
 
-void show_tree_os(void) {
-    vga_puts("File system tree:\n/\n");
-    
-    struct txt_file* f = files_head;
-    while (f) {
-        vga_printf("├── %s\n", f->name);
-        f = f->next;
-    }
-    
-    struct folder* dir = folders_head;
-    while (dir) {
-        if (!dir->parent) {
-            vga_printf("├── %s/\n", dir->name);
-            
-            struct txt_file* file = dir->files;
-            while (file) {
-                vga_printf("│   ├── %s\n", file->name);
-                file = file->next;
-            }
+void print_tree_recursive(fs_node_t* node, int level) {
+    for (fs_node_t* n = node->data.folder.children; n; n = n->next) {
+        for (int i = 0; i < level; i++) vga_puts("│   ");
+        if (n->type == TYPE_FOLDER) {
+            vga_printf("├── %s/\n", n->name->str);
+            print_tree_recursive(n, level + 1);
+        } else {
+            vga_printf("├── %s\n", n->name->str);
         }
-        dir = dir->next;
     }
 }
 
+void show_tree_os(void) {
+    vga_puts("File system tree:\n/\n");
+    print_tree_recursive(root_dir, 0);
+}
+
 void print_help(void) {
-    vga_puts("Available commands:\n");
-    vga_puts("help - Show this help\n");
-    vga_puts("clear - Clear screen\n");
-    vga_puts("graphics - Enter graphics mode\n");
-    vga_puts("add txt=<name> - Create text file\n");
-    vga_puts("open txt=<name> - Open text file\n");
-    vga_puts("open folder - List folders\n");
-    vga_puts("del=<name> - Delete file or folder\n");
-    vga_puts("ls - List files and folders\n");
-    vga_puts("add folder=<name> - Create folder\n");
-    vga_puts("cd=<name> - Change directory (use .. for parent, / for root)\n");
-    vga_puts("pwd - Show current directory\n");
-    vga_puts("tree - Show file system tree\n");
-    vga_puts("make c=<name> - Compile .c file to .xvr\n");
-    vga_puts("make py=<name> - Compile .py file to .xvr\n");
-    vga_puts("run=<name> - Run .xvr executable\n");
-    vga_puts("python=<name> - Run .py file directly\n");
-    vga_puts("exit - Exit the OS\n");
+    shell_print_help();
 }
 
 void add_txt(const char* name) {
-    if (!is_valid_name(name)) {
-        vga_puts("[X] Invalid filename\n");
+    char leaf[VFS_NAME_MAX + 1];
+    fs_node_t* dir = prepare_create(name, leaf, sizeof(leaf), "[X] Invalid filename\n");
+    if (!dir) {
         return;
     }
     
-    if (find_file(name)) {
-        vga_puts("[X] File already exists\n");
-        return;
-    }
-    
-    struct txt_file* f = (struct txt_file*)my_malloc(sizeof(struct txt_file));
+    fs_node_t* f = vfs_create(dir, leaf, TYPE_FILE);
     if (!f) {
         vga_puts("[X] Not enough memory\n");
         return;
     }
     
-    safe_string_copy(f->name, name, sizeof(f->name));
-    f->content = NULL;
-    f->content_size = 0;
-    f->next = NULL;
-    
     vga_puts("Enter file content (end with a single line containing only .):\n");
     
-    size_t buffer_size = 1024;
-    char* content_buffer = (char*)my_malloc(buffer_size);
-    if (!content_buffer) {
-        vga_puts("[X] Not enough memory for content\n");
-        my_free(f);
-        return;
-    }
-    
     char line_buf[MAX_INPUT_LINE];
-    size_t total_len = 0;
     
     while (1) {
         keyboard_readline(line_buf, sizeof(line_buf));
@@ -1150,97 +1184,63 @@ void add_txt(const char* name) {
             break;
         }
         
-        size_t line_len = strlen(line_buf);
-        
-        if (total_len + line_len + 2 > buffer_size) {
-            size_t new_size = buffer_size * 2;
-            char* new_buffer = (char*)my_malloc(new_size);
-            if (!new_buffer) {
-                vga_puts("[X] Not enough memory for content expansion\n");
-                my_free(content_buffer);
-                my_free(f);
-                return;
-            }
-            
-            for (size_t i = 0; i < total_len; i++) {
-                new_buffer[i] = content_buffer[i];
-            }
-            
-            my_free(content_buffer);
-            content_buffer = new_buffer;
-            buffer_size = new_size;
-        }
-        
-        for (size_t i = 0; i < line_len; i++) {
-            content_buffer[total_len++] = line_buf[i];
+        // Each line lands in the file's tail chunk; nothing is ever copied
+        if (!fs_append(f, line_buf, strlen(line_buf)) || !fs_append(f, "\n", 1)) {
+            vga_puts("[X] Not enough memory for content\n");
+            vfs_unlink(f);
+            return;
         }
-        content_buffer[total_len++] = '\n';
-    }
-    
-    content_buffer[total_len] = '\0';
-    f->content = content_buffer;
-    f->content_size = total_len;
-    
-    if (current_folder) {
-        f->next = current_folder->files;
-        current_folder->files = f;
-    } else {
-        f->next = files_head;
-        files_head = f;
     }
     
     vga_puts("[✓] File created successfully\n");
 }
 
 void add_folder(const char* name) {
-    if (!is_valid_name(name)) {
-        vga_puts("[X] Invalid folder name\n");
-        return;
-    }
-    
-    if (find_folder(name)) {
-        vga_puts("[X] Folder already exists\n");
+    char leaf[VFS_NAME_MAX + 1];
+    fs_node_t* dir = prepare_create(name, leaf, sizeof(leaf), "[X] Invalid folder name\n");
+    if (!dir) {
         return;
     }
     
-    struct folder* f = (struct folder*)my_malloc(sizeof(struct folder));
-    if (!f) {
+    if (!vfs_create(dir, leaf, TYPE_FOLDER)) {
         vga_puts("[X] Not enough memory\n");
         return;
     }
     
-    safe_string_copy(f->name, name, sizeof(f->name));
-    f->parent = current_folder;
-    f->files = NULL;
-    f->next = folders_head;
-    folders_head = f;
-    
     vga_puts("[✓] Folder created successfully\n");
 }
 
 void open_txt(const char* name) {
-    struct txt_file* f = find_file(name);
-    if (f && f->content) {
-        vga_puts(f->content);
-        if (f->content_size > 0 && f->content[f->content_size - 1] != '\n') {
-            vga_putc('\n');
-        }
-    } else {
+    fs_node_t* f = is_valid_path(name) ? find_file(name) : NULL;
+    if (!f) {
         vga_puts("[X] File not found\n");
+        return;
+    }
+    
+    char buf[257];
+    size_t off = 0;
+    size_t got;
+    char last = '\n';
+    while ((got = fs_read(f, off, buf, sizeof(buf) - 1)) > 0) {
+        buf[got] = '\0';
+        vga_puts(buf);
+        last = buf[got - 1];
+        off += got;
+    }
+    if (last != '\n') {
+        vga_putc('\n');
     }
 }
 
 void open_folder(void) {
-    struct folder* f = folders_head;
     vga_puts("Available folders:\n");
     bool found = false;
     
-    while (f) {
-        if (!current_folder || f->parent == current_folder) {
-            vga_printf("- %s\n", f->name);
+    for (fs_node_t* n = current_dir->data.folder.children; n; n = n->next) {
+        if (n->type == TYPE_FOLDER) {
+            vga_printf("- %s\n", n->name->str);
             found = true;
         }
-        f = f->next;
     }
     
     if (!found) {
@@ -1249,68 +1249,82 @@ void open_folder(void) {
 }
 
 void del(const char* target) {
-    if (!is_valid_name(target)) {
+    if (!is_valid_path(target)) {
         vga_puts("[X] Invalid name\n");
         return;
     }
     
-    struct txt_file** current_files_head = current_folder ? &(current_folder->files) : &files_head;
-    struct txt_file** pp = current_files_head;
-    
-    while (*pp) {
-        if (strcmp((*pp)->name, target) == 0) {
-            struct txt_file* to_del = *pp;
-            *pp = to_del->next;
-            
-            if (to_del->content) {
-                my_free(to_del->content);
-            }
-            my_free(to_del);
-            vga_puts("[✓] File deleted\n");
-            return;
-        }
-        pp = &((*pp)->next);
+    fs_node_t* node = vfs_resolve(target);
+    if (!node) {
+        vga_puts("[X] File or folder not found!\n");
+        return;
+    }
+    if (node == root_dir) {
+        vga_puts("[X] Cannot delete the root folder\n");
+        return;
     }
     
-    struct folder** fp = &folders_head;
-    while (*fp) {
-        if (strcmp((*fp)->name, target) == 0 && 
-            (!current_folder || (*fp)->parent == current_folder)) {
-            
-            struct folder* to_del = *fp;
-            
-            if (to_del->files != NULL) {
-                vga_puts("[X] Cannot delete non-empty folder\n");
-                return;
-            }
-            
-            if (current_folder == to_del) {
-                current_folder = to_del->parent;
-                update_current_path();
-            }
-            
-            *fp = to_del->next;
-            my_free(to_del);
-            vga_puts("[✓] Folder deleted\n");
-            return;
-        }
-        fp = &((*fp)->next);
+    bool is_file = node->type == TYPE_FILE;
+    if (!vfs_unlink(node)) {
+        vga_puts("[X] Cannot delete non-empty folder\n");
+        return;
     }
     
-    vga_puts("[X] File or folder not found!\n");
+    // Deleting the current folder moves up to its parent
+    update_current_path();
+    vga_puts(is_file ? "[✓] File deleted\n" : "[✓] Folder deleted\n");
+}
+
+void show_meminfo(void) {
+    heap_stats_t st;
+    heap_get_stats(&st);
+
+    size_t used = st.total_bytes - st.free_bytes;
+    int frag = 0;
+    if (st.free_bytes >= 100) {
+        frag = 100 - (int)(st.largest_free / (st.free_bytes / 100));
+        if (frag < 0) frag = 0;
+    }
+
+    vga_printf("RAM: %d KB in frames, %d KB free\n",
+               (int)(pmm_total_frames() * (PAGE_SIZE / 1024)),
+               (int)(pmm_free_frames_count() * (PAGE_SIZE / 1024)));
+    vga_printf("Heap: %d KB total, %d KB used, %d KB free\n",
+               (int)(st.total_bytes / 1024), (int)(used / 1024), (int)(st.free_bytes / 1024));
+    vga_printf("Free blocks: %d, largest %d bytes, fragmentation %d%%\n",
+               (int)st.free_blocks, (int)st.largest_free, frag);
+
+    vga_puts("Tag: live / peak bytes, allocs / frees\n");
+    for (int t = 0; t < HEAP_TAG_COUNT; t++) {
+        heap_tag_stats_t* ts = &st.tags[t];
+        vga_printf("  %s: %d / %d, %d / %d\n", heap_tag_name((heap_tag_t)t),
+                   (int)ts->live_bytes, (int)ts->peak_bytes, (int)ts->allocs, (int)ts->frees);
+    }
+
+    vga_puts("Slab caches: objects, slabs, object size\n");
+    for (slab_cache_t* c = slab_caches; c; c = c->next) {
+        vga_printf("  %s: %d, %d, %d\n", c->name, (int)c->active, (int)c->slabs, (int)c->obj_size);
+    }
+    vga_printf("Interned names: %d, %d bytes\n", (int)intern_count(), (int)intern_bytes());
+}
+
+void show_uptime(void) {
+    uint32_t s = timer_seconds();
+    vga_printf("Uptime: %d h %d min %d s (timer at %d Hz)\n",
+               (int)(s / 3600), (int)(s / 60 % 60), (int)(s % 60), (int)timer_hz());
 }
 
 // Real C Compiler
 void make_c_file(const char* name) {
-    if (!is_valid_name(name)) {
+    if (!is_valid_path(name)) {
         vga_puts("[X] Invalid filename\n");
         return;
     }
     
-    char source_name[300];
+    char source_name[VFS_PATH_MAX + 8];
     snprintf(source_name, sizeof(source_name), "%s.c", name);
     
-    struct txt_file* source_file = find_file(source_name);
+    fs_node_t* source_file = find_file(source_name);
     if (!source_file) {
         vga_printf("[X] Source file %s not found\n", source_name);
         return;
@@ -1319,9 +1333,16 @@ void make_c_file(const char* name) {
     vga_printf("C Compiler: Compiling %s.c to %s.xvr...\n", name, name);
     vga_puts("C Compiler: Lexical analysis...\n");
     
+    runtime = runtime_for_source(source_file);
+    if (!runtime) {
+        vga_puts("[X] Not enough memory to compile\n");
+        return;
+    }
+    
     // Real compilation
-    if (!compile_c_program(source_file->content)) {
+    if (!compile_c_program(source_file)) {
         vga_puts("[X] Compilation failed\n");
+        runtime_destroy(runtime);
         return;
     }
     
@@ -1329,7 +1350,9 @@ void make_c_file(const char* name) {
     vga_puts("C Compiler: Code generation...\n");
     
     // Create XVR executable
-    if (!create_xvr_file(name)) {
+    bool created = create_xvr_file(name);
+    runtime_destroy(runtime);
+    if (!created) {
         vga_puts("[X] Failed to create executable\n");
         return;
     }
@@ -1339,15 +1362,15 @@ void make_c_file(const char* name) {
 
 // Real Python Compiler
 void make_py_file(const char* name) {
-    if (!is_valid_name(name)) {
+    if (!is_valid_path(name)) {
         vga_puts("[X] Invalid filename\n");
         return;
     }
     
-    char source_name[300];
+    char source_name[VFS_PATH_MAX + 8];
     snprintf(source_name, sizeof(source_name), "%s.py", name);
     
-    struct txt_file* source_file = find_file(source_name);
+    fs_node_t* source_file = find_file(source_name);
     if (!source_file) {
         vga_printf("[X] Source file %s not found\n", source_name);
         return;
@@ -1356,9 +1379,16 @@ void make_py_file(const char* name) {
     vga_printf("Python Compiler: Compiling %s.py to %s.xvr...\n", name, name);
     vga_puts("Python Compiler: Tokenizing source code...\n");
     
+    runtime = runtime_for_source(source_file);
+    if (!runtime) {
+        vga_puts("[X] Not enough memory to compile\n");
+        return;
+    }
+    
     // Real compilation
-    if (!compile_python_program(source_file->content)) {
+    if (!compile_python_program(source_file)) {
         vga_puts("[X] Compilation failed\n");
+        runtime_destroy(runtime);
         return;
     }
     
@@ -1366,7 +1396,9 @@ void make_py_file(const char* name) {
     vga_puts("Python Compiler: Generating bytecode...\n");
     
     // Create XVR executable
-    if (!create_xvr_file(name)) {
+    bool created = create_xvr_file(name);
+    runtime_destroy(runtime);
+    if (!created) {
         vga_puts("[X] Failed to create executable\n");
         return;
     }
@@ -1376,7 +1408,7 @@ void make_py_file(const char* name) {
 
 // Real XVR Executor
 void run_executable(const char* name) {
-    if (!is_valid_name(name)) {
+    if (!is_valid_path(name)) {
         vga_puts("[X] Invalid filename\n");
         return;
     }
@@ -1393,6 +1425,10 @@ void run_executable(const char* name) {
     
     // Execute the real bytecode
     execute_xvr_program();
+    if (runtime->graphics_mode) {
+        graphics_until_esc();
+    }
+    runtime_destroy(runtime);
     
     vga_puts("\n=== End of Program ===\n");
     vga_printf("XVR Runtime: %s.xvr execution completed\n", name);
@@ -1400,15 +1436,15 @@ void run_executable(const char* name) {
 
 // Direct Python interpreter
 void run_python_directly(const char* name) {
-    if (!is_valid_name(name)) {
+    if (!is_valid_path(name)) {
         vga_puts("[X] Invalid filename\n");
         return;
     }
     
-    char py_name[300];
+    char py_name[VFS_PATH_MAX + 8];
     snprintf(py_name, sizeof(py_name), "%s.py", name);
     
-    struct txt_file* py_file = find_file(py_name);
+    fs_node_t* py_file = find_file(py_name);
     if (!py_file) {
         vga_printf("[X] Python file %s not found\n", py_name);
         return;
@@ -1418,85 +1454,193 @@ void run_python_directly(const char* name) {
     vga_puts("=== Python Direct Execution ===\n");
     
     // Compile and execute directly
-    if (compile_python_program(py_file->content)) {
+    runtime = runtime_for_source(py_file);
+    if (compile_python_program(py_file)) {
         execute_xvr_program();
+        if (runtime->graphics_mode) {
+            graphics_until_esc();
+        }
     } else {
         vga_puts("[X] Python interpretation failed\n");
     }
+    runtime_destroy(runtime);
     
     vga_puts("=== End of Python Execution ===\n");
 }
 
+static void heap_totals(size_t* bytes, size_t* allocs) {
+    heap_stats_t st;
+    heap_get_stats(&st);
+    *bytes = 0;
+    *allocs = 0;
+    for (int t = 0; t < HEAP_TAG_COUNT; t++) {
+        *bytes += st.tags[t].alloc_bytes;
+        *allocs += st.tags[t].allocs;
+    }
+}
+
+// `time <command>`: runs the command, then reports wall time, TSC cycles
+// and how much it allocated from the heap
+static void time_command(const char* cmd) {
+    size_t bytes0, allocs0, bytes1, allocs1;
+    heap_totals(&bytes0, &allocs0);
+    uint64_t c0 = clock_cycles();
+    uint64_t t0 = clock_now();
+
+    bool handled = commands_handle(cmd);
+
+    uint64_t t1 = clock_now();
+    uint64_t c1 = clock_cycles();
+    heap_totals(&bytes1, &allocs1);
+
+    if (!handled) {
+        vga_puts("[X] Unknown command\n");
+        return;
+    }
+    char wall[32], cycles[21];
+    clock_format_ns(wall, sizeof(wall), t1 - t0);
+    if (c0) {
+        clock_format_u64(cycles, c1 - c0);
+    } else {
+        strcpy(cycles, "n/a");
+    }
+    vga_printf("[time] wall %s, %s cycles, %d bytes allocated in %d allocations\n",
+               wall, cycles, (int)(bytes1 - bytes0), (int)(allocs1 - allocs0));
+}
+
+// --- command registration ---------------------------------------------------
+//
+// All tables live here rather than next to vfs, diskfs or the compiler:
+// every handler is a console front end built from this file's path and
+// runtime helpers, and the subsystems underneath stay free of shell.h.
+// A subsystem with its own commands outside this file calls shell_register
+// from its init instead.
+
+static void cmd_help(const char* arg) { (void)arg; print_help(); }
+static void cmd_clear(const char* arg) { (void)arg; vga_clear(); }
+static void cmd_meminfo(const char* arg) { (void)arg; show_meminfo(); }
+static void cmd_uptime(const char* arg) { (void)arg; show_uptime(); }
+static void cmd_open_folder(const char* arg) { (void)arg; open_folder(); }
+static void cmd_ls(const char* arg) { (void)arg; list_files_and_folders(); }
+static void cmd_pwd(const char* arg) { (void)arg; print_current_directory(); }
+static void cmd_tree(const char* arg) { (void)arg; show_tree_os(); }
+
+static void cmd_format(const char* arg) {
+    (void)arg;
+    if (diskfs_format()) {
+        vga_printf("[OK] Formatted %s: %d blocks free\n",
+                   diskfs_device()->name, (int)diskfs_free_blocks());
+    }
+}
+
+static void cmd_mount(const char* arg) {
+    (void)arg;
+    if (diskfs_mount()) {
+        update_current_path();
+        vga_printf("[OK] Mounted %s\n", diskfs_device()->name);
+    }
+}
+
+static void cmd_sync(const char* arg) {
+    (void)arg;
+    if (diskfs_sync()) {
+        vga_printf("[OK] Synced, %d of %d blocks free\n",
+                   (int)diskfs_free_blocks(), (int)diskfs_total_blocks());
+    }
+}
+
+static void cmd_cache(const char* arg) {
+    (void)arg;
+    bcache_stats_t st;
+    bcache_get_stats(&st);
+    uint32_t lookups = st.hits + st.misses;
+    vga_printf("Block cache: %d of %d blocks, %d dirty\n",
+               (int)st.cached, BCACHE_MAX_BLOCKS, (int)st.dirty);
+    vga_printf("Hits: %d, misses: %d (%d%% hit rate)\n", (int)st.hits, (int)st.misses,
+               lookups ? (int)(st.hits * 100u / lookups) : 0);
+    vga_printf("Read-ahead: %d blocks, evictions: %d, write-backs: %d\n",
+               (int)st.readahead, (int)st.evictions, (int)st.writebacks);
+}
+
+static void cmd_lspci(const char* arg) {
+    (void)arg;
+    for (int i = 0; i < pci_scan(); i++) {
+        const pci_device_t* d = pci_device(i);
+        vga_printf("%d:%d.%d  %x:%x  class %x.%x",
+                   d->addr.bus, d->addr.dev, d->addr.fn, d->vendor, d->device,
+                   d->class_code, d->subclass);
+        if (d->irq != PCI_IRQ_NONE) vga_printf("  irq %d", d->irq);
+        vga_putc('\n');
+    }
+}
+
+static void cmd_graphics(const char* arg) {
+    (void)arg;
+    vga_puts("Entering graphics mode...\n");
+    vga_init_graphics();
+    graphics_until_esc();
+    vga_setcolor(VGA_COLOR_WHITE, VGA_COLOR_BLUE);
+    vga_clear();
+    vga_puts("Returned to text mode\n");
+}
+
+static const shell_command_t system_commands[] = {
+    { "help",     SHELL_ARG_NONE, NULL,      cmd_help,     "Show this help" },
+    { "clear",    SHELL_ARG_NONE, NULL,      cmd_clear,    "Clear screen" },
+    { "graphics", SHELL_ARG_NONE, NULL,      cmd_graphics, "Enter graphics mode" },
+    { "meminfo",  SHELL_ARG_NONE, NULL,      cmd_meminfo,  "Show heap usage" },
+    { "uptime",   SHELL_ARG_NONE, NULL,      cmd_uptime,   "Show time since boot" },
+    { "lspci",    SHELL_ARG_NONE, NULL,      cmd_lspci,    "List PCI devices" },
+    { "time",     SHELL_ARG_REST, "command", time_command, "Run a command and show its run time" },
+};
+
+static const shell_command_t fs_commands[] = {
+    { "add txt",     SHELL_ARG_EQ,   "name", add_txt,         "Create text file" },
+    { "open txt",    SHELL_ARG_EQ,   "name", open_txt,        "Open text file" },
+    { "open folder", SHELL_ARG_NONE, NULL,   cmd_open_folder, "List folders" },
+    { "del",         SHELL_ARG_EQ,   "name", del,             "Delete file or folder" },
+    { "ls",          SHELL_ARG_NONE, NULL,   cmd_ls,          "List files and folders" },
+    { "add folder",  SHELL_ARG_EQ,   "name", add_folder,      "Create folder" },
+    { "cd",          SHELL_ARG_EQ,   "name", change_directory,
+      "Change directory (use .. for parent, / for root)" },
+    { "pwd",         SHELL_ARG_NONE, NULL,   cmd_pwd,         "Show current directory" },
+    { "tree",        SHELL_ARG_NONE, NULL,   cmd_tree,        "Show file system tree" },
+    { "format",      SHELL_ARG_NONE, NULL,   cmd_format,      "Create an empty file system on disk" },
+    { "mount",       SHELL_ARG_NONE, NULL,   cmd_mount,       "Load files from disk" },
+    { "sync",        SHELL_ARG_NONE, NULL,   cmd_sync,        "Write changed files to disk" },
+    { "cache",       SHELL_ARG_NONE, NULL,   cmd_cache,       "Show block cache statistics" },
+};
+
+static const shell_command_t compiler_commands[] = {
+    { "make c",  SHELL_ARG_EQ, "name", make_c_file,  "Compile .c file to .xvr" },
+    { "make py", SHELL_ARG_EQ, "name", make_py_file, "Compile .py file to .xvr" },
+};
+
+static const shell_command_t vm_commands[] = {
+    { "run",    SHELL_ARG_EQ, "name", run_executable,      "Run .xvr executable" },
+    { "python", SHELL_ARG_EQ, "name", run_python_directly, "Run .py file directly" },
+};
+
+#define COUNT(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+void commands_init(void) {
+    static bool registered = false;
+    if (registered) return;
+    registered = true;
+    shell_register(system_commands, COUNT(system_commands));
+    shell_register(fs_commands, COUNT(fs_commands));
+    shell_register(compiler_commands, COUNT(compiler_commands));
+    shell_register(vm_commands, COUNT(vm_commands));
+}
+
 // Command handler
 bool commands_handle(const char* input) {
     if (!input || !*input) {
         return false;
     }
+    commands_init();
     
     while (*input == ' ' || *input == '\t') input++;
     
-    if (strncmp(input, "add txt=", 8) == 0) {
-        add_txt(input + 8);
-        return true;
-    } else if (strncmp(input, "add folder=", 11) == 0) {
-        add_folder(input + 11);
-        return true;
-    } else if (strncmp(input, "open txt=", 9) == 0) {
-        open_txt(input + 9);
-        return true;
-    } else if (strcmp(input, "open folder") == 0) {
-        open_folder();
-        return true;
-    } else if (strncmp(input, "del=", 4) == 0) {
-        del(input + 4);
-        return true;
-    } else if (strcmp(input, "help") == 0) {
-        print_help();
-        return true;
-    } else if (strcmp(input, "clear") == 0) {
-        vga_clear();
-        return true;
-    } else if (strcmp(input, "ls") == 0) {
-        list_files_and_folders();
-        return true;
-    } else if (strcmp(input, "pwd") == 0) {
-        print_current_directory();
-        return true;
-    } else if (strncmp(input, "cd=", 3) == 0) {
-        change_directory(input + 3);
-        return true;
-    } else if (strcmp(input, "tree") == 0) {
-        show_tree_os();
-        return true;
-    } else if (strncmp(input, "make c=", 7) == 0) {
-        make_c_file(input + 7);
-        return true;
-    } else if (strncmp(input, "make py=", 8) == 0) {
-        make_py_file(input + 8);
-        return true;
-    } else if (strncmp(input, "run=", 4) == 0) {
-        run_executable(input + 4);
-        return true;
-    } else if (strncmp(input, "python=", 7) == 0) {
-        run_python_directly(input + 7);
-        return true;
-    } else if (strcmp(input, "graphics") == 0) {
-        vga_puts("Entering graphics mode...\n");
-        vga_init_graphics();
-        
-        while (1) {
-            if (keyboard_check_esc()) {
-                vga_init_text();
-                vga_setcolor(VGA_COLOR_WHITE, VGA_COLOR_BLUE);
-                vga_clear();
-                vga_puts("Returned to text mode\n");
-                return true;
-            }
-            
-            for (volatile int i = 0; i < 100000; i++);
-        }
-        return true;
-    }
-    
-    return false;
-}
\ No newline at end of file
+    return shell_dispatch(input);
+}
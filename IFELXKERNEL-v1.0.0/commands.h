@@ -3,33 +3,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
-
-// File system node types
-typedef enum {
-    TYPE_FILE,
-    TYPE_FOLDER
-} node_type_t;
-
-// File system node structure
-typedef struct fs_node {
-    char name[256];
-    node_type_t type;
-    union {
-        struct {
-            char* content;
-            size_t size;
-        } file;
-        struct {
-            struct fs_node* children;
-            struct fs_node* parent;
-            struct fs_node* next;
-        } folder;
-    } data;
-} fs_node_t;
-
-// Global variables
-extern fs_node_t* root_dir;
-extern fs_node_t* current_dir;
+#include "vfs.h"
 
 typedef struct network {
     char name[64];
@@ -40,23 +14,6 @@ typedef struct network {
 
 extern network_t* networks_head;
 
-typedef struct txt_file {
-    char name[256];
-    char* content;
-    size_t content_size;
-    struct txt_file* next;
-} txt_file_t;
-
-typedef struct folder {
-    char name[256];
-    struct folder* parent;
-    struct folder* next;
-    struct txt_file* files;
-} folder_t;
-
-extern txt_file_t* files_head;
-extern folder_t* folders_head;
-
 extern bool batch_mode;
 extern int final_number;
 
@@ -83,15 +40,6 @@ void* my_malloc(size_t size);
 void my_free(void* ptr);
 void* my_realloc(void* ptr, size_t size);
 
-// File system functions
-fs_node_t create_file(const char* name);
-fs_node_t create_folder(const char* name);
-void init_filesystem(void);
-fs_node_t* find_node(const char* name);
-bool add_node(fs_node_t* node);
-void free_node(fs_node_t* node);
-void ensure_filesystem(void);
-
 // File system commands
 void list_files_and_folders(void);
 void print_current_directory(void);
@@ -104,6 +52,8 @@ void open_txt(const char* name);
 void open_folder(void);
 void del(const char* target);
 void print_tree_recursive(fs_node_t* node, int level);
+void show_meminfo(void);
+void show_uptime(void);
 
 // Command handlers
 void make_xvr(const char* name);
@@ -118,6 +68,7 @@ void skip_whitespace(const char** str);
 char get_argument(const char* input, const char* prefix);
 
 // Main command handler
+void commands_init(void);
 bool commands_handle(const char* input);
 
 // Keyboard functions (from keyboard.h)
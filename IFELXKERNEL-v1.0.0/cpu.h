@@ -0,0 +1,101 @@
+#ifndef CPU_H
+#define CPU_H
+#include <stdint.h>
+#include <stdbool.h>
+
+// CPUID.1:EDX feature bits
+#define CPUID_FEAT_PSE  (1u << 3)
+#define CPUID_FEAT_TSC  (1u << 4)
+#define CPUID_FEAT_MSR  (1u << 5)
+#define CPUID_FEAT_MTRR (1u << 12)
+#define CPUID_FEAT_PAT  (1u << 16)
+
+static inline bool cpuid_supported(void) {
+    uint32_t before, after;
+    __asm__ volatile (
+        "pushfl\n\t"
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "movl %0, %1\n\t"
+        "xorl $0x200000, %0\n\t"
+        "pushl %0\n\t"
+        "popfl\n\t"
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "popfl"
+        : "=&r"(after), "=&r"(before));
+    return (before ^ after) & 0x200000;
+}
+
+static inline void cpuid(uint32_t leaf, uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d) {
+    __asm__ volatile ("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(0));
+}
+
+static inline uint32_t cpuid_features(void) {
+    uint32_t a, b, c, d;
+    if (!cpuid_supported()) return 0;
+    cpuid(1, &a, &b, &c, &d);
+    return d;
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline uint32_t read_cr0(void) {
+    uint32_t v;
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr0(uint32_t v) {
+    __asm__ volatile ("mov %0, %%cr0" : : "r"(v) : "memory");
+}
+
+static inline void write_cr3(uint32_t v) {
+    __asm__ volatile ("mov %0, %%cr3" : : "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t v;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr4(uint32_t v) {
+    __asm__ volatile ("mov %0, %%cr4" : : "r"(v) : "memory");
+}
+
+static inline void wbinvd(void) {
+    __asm__ volatile ("wbinvd" : : : "memory");
+}
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// 64-by-32 division with two divl steps; plain `/` on a uint64_t would call
+// libgcc's __udivdi3, which the kernel does not link.
+static inline uint64_t div_u64(uint64_t n, uint32_t d, uint32_t* rem) {
+    uint32_t hi = (uint32_t)(n >> 32), lo = (uint32_t)n;
+    uint32_t qhi = hi / d;
+    uint32_t r = hi % d;
+    uint32_t qlo;
+    __asm__ ("divl %4" : "=a"(qlo), "=d"(r) : "a"(lo), "d"(r), "rm"(d));
+    if (rem) *rem = r;
+    return ((uint64_t)qhi << 32) | qlo;
+}
+
+static inline void invlpg(uintptr_t addr) {
+    __asm__ volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+#endif // CPU_H
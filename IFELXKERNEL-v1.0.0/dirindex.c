@@ -0,0 +1,76 @@
+#include "dirindex.h"
+#include "heap.h"
+#include "mini_string.h"
+
+#define DIR_INDEX_MIN 8
+
+static dir_slot_t* probe(const dir_index_t* idx, const istr_t* key) {
+    uint32_t mask = idx->cap - 1;
+    for (uint32_t i = key->hash & mask;; i = (i + 1) & mask) {
+        dir_slot_t* s = &idx->slots[i];
+        if (!s->key || s->key == key) return s;
+    }
+}
+
+void* dir_index_find(const dir_index_t* idx, const istr_t* key) {
+    if (!idx->count) return NULL;
+    dir_slot_t* s = probe(idx, key);
+    return s->key ? s->item : NULL;
+}
+
+static bool grow(dir_index_t* idx) {
+    uint32_t cap = idx->cap ? idx->cap * 2 : DIR_INDEX_MIN;
+    dir_slot_t* slots = (dir_slot_t*)my_malloc_tag(cap * sizeof(dir_slot_t), HEAP_TAG_FS);
+    if (!slots) return false;
+    memset(slots, 0, cap * sizeof(dir_slot_t));
+
+    dir_index_t bigger = { slots, cap, idx->count };
+    for (uint32_t i = 0; i < idx->cap; i++) {
+        dir_slot_t* old = &idx->slots[i];
+        if (old->key) *probe(&bigger, old->key) = *old;
+    }
+    my_free(idx->slots);
+    *idx = bigger;
+    return true;
+}
+
+bool dir_index_insert(dir_index_t* idx, const istr_t* key, void* item) {
+    // Keep the load at or below 3/4 so probe runs stay short
+    if ((idx->count + 1) * 4 > idx->cap * 3 && !grow(idx)) return false;
+    dir_slot_t* s = probe(idx, key);
+    if (s->key) return false;
+    s->key = key;
+    s->item = item;
+    idx->count++;
+    return true;
+}
+
+// Backward-shift deletion: later members of the probe run move into the
+// hole, so the table never needs tombstones.
+void* dir_index_remove(dir_index_t* idx, const istr_t* key) {
+    if (!idx->count) return NULL;
+    dir_slot_t* s = probe(idx, key);
+    if (!s->key) return NULL;
+    void* item = s->item;
+
+    uint32_t mask = idx->cap - 1;
+    uint32_t hole = (uint32_t)(s - idx->slots);
+    for (uint32_t i = (hole + 1) & mask; idx->slots[i].key; i = (i + 1) & mask) {
+        uint32_t home = idx->slots[i].key->hash & mask;
+        // Move the entry if its home is not in (hole, i]
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            idx->slots[hole] = idx->slots[i];
+            hole = i;
+        }
+    }
+    idx->slots[hole].key = NULL;
+    idx->count--;
+    return item;
+}
+
+void dir_index_free(dir_index_t* idx) {
+    my_free(idx->slots);
+    idx->slots = NULL;
+    idx->cap = 0;
+    idx->count = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef DIRINDEX_H
+#define DIRINDEX_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "intern.h"
+
+// Name -> entry map for one directory: open addressing with linear probing.
+// Keys are interned names, so a probe compares pointers and only touches
+// the key's precomputed hash when entries move.
+
+typedef struct {
+    const istr_t* key;  // NULL marks an empty slot
+    void* item;
+} dir_slot_t;
+
+typedef struct {
+    dir_slot_t* slots;
+    uint32_t cap;      // power of two, 0 until the first insert
+    uint32_t count;
+} dir_index_t;
+
+#define DIR_INDEX_INIT { NULL, 0, 0 }
+
+void* dir_index_find(const dir_index_t* idx, const istr_t* key);
+bool dir_index_insert(dir_index_t* idx, const istr_t* key, void* item);
+void* dir_index_remove(dir_index_t* idx, const istr_t* key);
+void dir_index_free(dir_index_t* idx);
+
+#endif // DIRINDEX_H
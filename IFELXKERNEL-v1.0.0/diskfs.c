@@ -0,0 +1,723 @@
+#include "diskfs.h"
+#include "vfs.h"
+#include "heap.h"
+#include "vga.h"
+#include "mini_string.h"
+
+#define DISKFS_MAGIC 0x46584649u    // "IFXF"
+#define DISKFS_VERSION 1
+#define SECTORS_PER_BLOCK (DISKFS_BLOCK_SIZE / BLKDEV_SECTOR_SIZE)
+#define BITS_PER_BLOCK (DISKFS_BLOCK_SIZE * 8)
+
+#define DISKFS_EXTENTS 30
+#define INODES_PER_BLOCK (DISKFS_BLOCK_SIZE / sizeof(diskfs_inode_t))
+#define INODES_MIN 64
+#define INODES_MAX 8192
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t total_blocks;
+    uint32_t bitmap_start;
+    uint32_t bitmap_blocks;
+    uint32_t inode_start;
+    uint32_t inode_blocks;
+    uint32_t inode_count;
+    uint32_t data_start;
+} diskfs_super_t;
+
+typedef struct {
+    uint32_t start;
+    uint32_t count;
+} diskfs_extent_t;
+
+enum { INODE_FREE, INODE_FILE, INODE_FOLDER };
+
+// Inode 0 is never used: as a parent it means the root folder
+typedef struct {
+    uint8_t type;
+    uint8_t name_len;
+    uint16_t extent_count;
+    uint32_t parent;
+    uint32_t size;
+    uint32_t reserved;
+    diskfs_extent_t extents[DISKFS_EXTENTS];
+    char name[256];
+} diskfs_inode_t;
+
+_Static_assert(sizeof(diskfs_inode_t) == 512, "inodes must tile a block");
+
+// Extent list kept in fs_node_t.file.backing for files read from disk
+typedef struct {
+    uint32_t count;
+    diskfs_extent_t extents[];
+} diskfs_backing_t;
+
+static blkdev_t* disk = NULL;
+static bool mounted = false;
+static diskfs_super_t sb;
+static uint8_t* block_map = NULL;   // sb.bitmap_blocks blocks, bit set = used
+static uint8_t* freed_map = NULL;   // same size; freed blocks not yet reusable
+static uint8_t* inode_map = NULL;   // one bit per inode, set = used
+static uint32_t free_blocks = 0;
+static uint8_t block_buf[DISKFS_BLOCK_SIZE] __attribute__((aligned(4)));
+static const vnode_ops_t diskfs_file_ops;
+
+// --- block and bitmap helpers ---------------------------------------------
+
+static bool read_blocks(uint32_t block, uint32_t count, void* buf) {
+    return disk->read(disk, DISKFS_START_LBA + block * SECTORS_PER_BLOCK,
+                      count * SECTORS_PER_BLOCK, buf);
+}
+
+static bool write_blocks(uint32_t block, uint32_t count, const void* buf) {
+    return disk->write(disk, DISKFS_START_LBA + block * SECTORS_PER_BLOCK,
+                       count * SECTORS_PER_BLOCK, buf);
+}
+
+static bool bit_test(const uint8_t* map, uint32_t i) {
+    return map[i / 8] & (1u << (i % 8));
+}
+
+static void bit_set(uint8_t* map, uint32_t i, bool on) {
+    if (on) map[i / 8] |= (uint8_t)(1u << (i % 8));
+    else map[i / 8] &= (uint8_t)~(1u << (i % 8));
+}
+
+static void free_extents(const diskfs_extent_t* ext, uint32_t count) {
+    for (uint32_t e = 0; e < count; e++) {
+        for (uint32_t b = 0; b < ext[e].count; b++) {
+            bit_set(block_map, ext[e].start + b, false);
+        }
+        free_blocks += ext[e].count;
+    }
+}
+
+// Blocks an inode on disk may still point at: they stay allocated until a
+// sync has made the inode that dropped them durable
+static void defer_free(const diskfs_extent_t* ext, uint32_t count) {
+    for (uint32_t e = 0; e < count; e++) {
+        for (uint32_t b = 0; b < ext[e].count; b++) {
+            bit_set(freed_map, ext[e].start + b, true);
+        }
+    }
+}
+
+static void release_freed(void) {
+    for (uint32_t b = 0; b < sb.total_blocks; b++) {
+        if (!bit_test(freed_map, b)) continue;
+        bit_set(freed_map, b, false);
+        bit_set(block_map, b, false);
+        free_blocks++;
+    }
+}
+
+// Longest free run starting at or after `from`, capped at `want`
+static uint32_t free_run(uint32_t from, uint32_t want, uint32_t* start) {
+    uint32_t best = 0;
+    for (uint32_t b = from; b < sb.total_blocks;) {
+        if (bit_test(block_map, b)) {
+            b++;
+            continue;
+        }
+        uint32_t len = 0;
+        while (b + len < sb.total_blocks && len < want && !bit_test(block_map, b + len)) len++;
+        if (len > best) {
+            best = len;
+            *start = b;
+            if (len == want) break;
+        }
+        b += len;
+    }
+    return best;
+}
+
+// Contiguous if any run is long enough, otherwise longest runs first
+static bool alloc_extents(uint32_t blocks, diskfs_inode_t* ino) {
+    ino->extent_count = 0;
+    if (blocks > free_blocks) return false;
+    while (blocks) {
+        uint32_t start = 0;
+        uint32_t len = ino->extent_count < DISKFS_EXTENTS ? free_run(sb.data_start, blocks, &start) : 0;
+        if (!len) {
+            free_extents(ino->extents, ino->extent_count);
+            ino->extent_count = 0;
+            return false;
+        }
+        for (uint32_t b = 0; b < len; b++) bit_set(block_map, start + b, true);
+        free_blocks -= len;
+        ino->extents[ino->extent_count].start = start;
+        ino->extents[ino->extent_count].count = len;
+        ino->extent_count++;
+        blocks -= len;
+    }
+    return true;
+}
+
+// Disk block holding block `index` of a file
+static uint32_t map_block(const diskfs_extent_t* ext, uint32_t count, uint32_t index) {
+    for (uint32_t e = 0; e < count; e++) {
+        if (index < ext[e].count) return ext[e].start + index;
+        index -= ext[e].count;
+    }
+    return 0;
+}
+
+static bool read_inode(uint32_t i, diskfs_inode_t* out) {
+    if (!read_blocks(sb.inode_start + i / INODES_PER_BLOCK, 1, block_buf)) return false;
+    memcpy(out, block_buf + (i % INODES_PER_BLOCK) * sizeof(diskfs_inode_t), sizeof(*out));
+    return true;
+}
+
+static bool write_inode(uint32_t i, const diskfs_inode_t* in) {
+    uint32_t block = sb.inode_start + i / INODES_PER_BLOCK;
+    if (!read_blocks(block, 1, block_buf)) return false;
+    memcpy(block_buf + (i % INODES_PER_BLOCK) * sizeof(diskfs_inode_t), in, sizeof(*in));
+    return write_blocks(block, 1, block_buf);
+}
+
+// --- files whose body is still on disk ----------------------------------
+
+static size_t diskfs_read(fs_node_t* file, size_t off, void* buf, size_t len) {
+    diskfs_backing_t* bk = (diskfs_backing_t*)file->data.file.backing;
+    size_t size = file->data.file.size;
+    if (off >= size) return 0;
+    if (len > size - off) len = size - off;
+
+    char* out = (char*)buf;
+    size_t done = 0;
+    while (done < len) {
+        uint32_t index = (uint32_t)((off + done) / DISKFS_BLOCK_SIZE);
+        size_t in = (off + done) % DISKFS_BLOCK_SIZE;
+        size_t n = DISKFS_BLOCK_SIZE - in;
+        if (n > len - done) n = len - done;
+        uint32_t block = map_block(bk->extents, bk->count, index);
+        if (!block || !read_blocks(block, 1, block_buf)) break;
+        memcpy(out + done, block_buf + in, n);
+        done += n;
+    }
+    return done;
+}
+
+static void diskfs_release(fs_node_t* node) {
+    my_free(node->data.file.backing);
+    node->data.file.backing = NULL;
+    ramfs_ops.release(node);
+}
+
+// Copies the body into RAM chunks; the node is an ordinary in-memory file
+// afterwards and reaches the disk again on the next sync.
+static bool materialize(fs_node_t* file) {
+    diskfs_backing_t* bk = (diskfs_backing_t*)file->data.file.backing;
+    size_t size = file->data.file.size;
+    file->ops = &ramfs_ops;
+    file->data.file.backing = NULL;
+    file->data.file.size = 0;
+
+    for (size_t off = 0; off < size; off += DISKFS_BLOCK_SIZE) {
+        size_t n = size - off < DISKFS_BLOCK_SIZE ? size - off : DISKFS_BLOCK_SIZE;
+        uint32_t block = map_block(bk->extents, bk->count, (uint32_t)(off / DISKFS_BLOCK_SIZE));
+        if (!block || !read_blocks(block, 1, block_buf) || !ramfs_ops.append(file, block_buf, n)) {
+            ramfs_ops.truncate(file, 0);
+            file->ops = &diskfs_file_ops;
+            file->data.file.backing = bk;
+            file->data.file.size = size;
+            return false;
+        }
+    }
+    my_free(bk);
+    return true;
+}
+
+static bool diskfs_append(fs_node_t* file, const void* data, size_t len) {
+    return materialize(file) && file->ops->append(file, data, len);
+}
+
+static bool diskfs_truncate(fs_node_t* file, size_t size) {
+    if (size == 0) {
+        // Nothing to copy: drop the disk body and start empty in RAM
+        my_free(file->data.file.backing);
+        file->data.file.backing = NULL;
+        file->data.file.size = 0;
+        file->ops = &ramfs_ops;
+        return true;
+    }
+    return materialize(file) && file->ops->truncate(file, size);
+}
+
+static const vnode_ops_t diskfs_file_ops = {
+    .release = diskfs_release,
+    .read = diskfs_read,
+    .append = diskfs_append,
+    .truncate = diskfs_truncate,
+};
+
+// --- format and mount ------------------------------------------------------
+
+void diskfs_attach(blkdev_t* dev) {
+    disk = dev;
+    mounted = false;
+}
+
+blkdev_t* diskfs_device(void) {
+    return disk;
+}
+
+bool diskfs_mounted(void) {
+    return mounted;
+}
+
+uint32_t diskfs_free_blocks(void) {
+    return mounted ? free_blocks : 0;
+}
+
+uint32_t diskfs_total_blocks(void) {
+    return mounted ? sb.total_blocks : 0;
+}
+
+static void unmount(void) {
+    my_free(block_map);
+    my_free(freed_map);
+    my_free(inode_map);
+    block_map = NULL;
+    freed_map = NULL;
+    inode_map = NULL;
+    mounted = false;
+}
+
+// Allocates the in-memory maps for `sb`; the block map is left zeroed
+static bool alloc_maps(void) {
+    block_map = (uint8_t*)my_malloc_tag(sb.bitmap_blocks * DISKFS_BLOCK_SIZE, HEAP_TAG_FS);
+    freed_map = (uint8_t*)my_malloc_tag(sb.bitmap_blocks * DISKFS_BLOCK_SIZE, HEAP_TAG_FS);
+    inode_map = (uint8_t*)my_malloc_tag(sb.inode_count / 8, HEAP_TAG_FS);
+    if (!block_map || !freed_map || !inode_map) {
+        unmount();
+        vga_puts("[X] Not enough memory for the disk maps\n");
+        return false;
+    }
+    memset(block_map, 0, sb.bitmap_blocks * DISKFS_BLOCK_SIZE);
+    memset(freed_map, 0, sb.bitmap_blocks * DISKFS_BLOCK_SIZE);
+    memset(inode_map, 0, sb.inode_count / 8);
+    return true;
+}
+
+static bool forget_disk_nodes(fs_node_t* dir) {
+    for (fs_node_t* n = dir->data.folder.children; n; n = n->next) {
+        if (n->type == TYPE_FOLDER) {
+            if (!forget_disk_nodes(n)) return false;
+        } else if (n->ops == &diskfs_file_ops && !materialize(n)) {
+            return false;
+        }
+        n->ino = 0;
+        n->dirty = true;
+    }
+    return true;
+}
+
+bool diskfs_format(void) {
+    if (!disk) {
+        vga_puts("[X] No disk attached\n");
+        return false;
+    }
+    if (disk->sectors < DISKFS_START_LBA + 64 * SECTORS_PER_BLOCK) {
+        vga_puts("[X] Disk too small\n");
+        return false;
+    }
+    // Bodies still on the old disk must come into RAM before it is wiped
+    if (!forget_disk_nodes(root_dir)) {
+        vga_puts("[X] Not enough memory to keep the mounted files\n");
+        return false;
+    }
+    unmount();
+
+    memset(&sb, 0, sizeof(sb));
+    sb.magic = DISKFS_MAGIC;
+    sb.version = DISKFS_VERSION;
+    sb.block_size = DISKFS_BLOCK_SIZE;
+    sb.total_blocks = (disk->sectors - DISKFS_START_LBA) / SECTORS_PER_BLOCK;
+    sb.bitmap_start = 1;
+    sb.bitmap_blocks = (sb.total_blocks + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+    sb.inode_count = sb.total_blocks / 8;
+    if (sb.inode_count < INODES_MIN) sb.inode_count = INODES_MIN;
+    if (sb.inode_count > INODES_MAX) sb.inode_count = INODES_MAX;
+    sb.inode_count -= sb.inode_count % INODES_PER_BLOCK;
+    sb.inode_start = sb.bitmap_start + sb.bitmap_blocks;
+    sb.inode_blocks = sb.inode_count / INODES_PER_BLOCK;
+    sb.data_start = sb.inode_start + sb.inode_blocks;
+
+    if (!alloc_maps()) return false;
+    for (uint32_t b = 0; b < sb.data_start; b++) bit_set(block_map, b, true);
+    free_blocks = sb.total_blocks - sb.data_start;
+    bit_set(inode_map, 0, true);
+
+    bool ok = true;
+    memset(block_buf, 0, sizeof(block_buf));
+    for (uint32_t b = 0; ok && b < sb.inode_blocks; b++) {
+        ok = write_blocks(sb.inode_start + b, 1, block_buf);
+    }
+    ok = ok && write_blocks(sb.bitmap_start, sb.bitmap_blocks, block_map);
+    memcpy(block_buf, &sb, sizeof(sb));
+    ok = ok && write_blocks(0, 1, block_buf) && disk->flush(disk);
+    if (!ok) {
+        unmount();
+        vga_puts("[X] Disk write failed\n");
+        return false;
+    }
+    mounted = true;
+    return true;
+}
+
+// A file's extents must lie in the data area and cover its size, or a
+// later read, sync or delete would touch blocks outside the maps
+static bool extents_valid(const diskfs_inode_t* ino) {
+    if (ino->extent_count > DISKFS_EXTENTS) return false;
+    uint64_t blocks = 0;
+    for (uint32_t e = 0; e < ino->extent_count; e++) {
+        const diskfs_extent_t* ext = &ino->extents[e];
+        if (ext->start < sb.data_start || ext->start >= sb.total_blocks ||
+            ext->count > sb.total_blocks - ext->start) {
+            return false;
+        }
+        blocks += ext->count;
+    }
+    return ino->size <= blocks * DISKFS_BLOCK_SIZE;
+}
+
+// Creates the node for a used inode under an already loaded parent
+static fs_node_t* load_node(fs_node_t* parent, const diskfs_inode_t* ino) {
+    if (parent->type != TYPE_FOLDER || ino->type > INODE_FOLDER) return NULL;
+    if (ino->type == INODE_FILE && !extents_valid(ino)) return NULL;
+    char name[256];
+    memcpy(name, ino->name, ino->name_len);
+    name[ino->name_len] = '\0';
+    fs_node_t* node = vfs_create(parent, name, ino->type == INODE_FILE ? TYPE_FILE : TYPE_FOLDER);
+    if (!node) return NULL;
+
+    if (ino->type == INODE_FILE) {
+        uint32_t count = ino->extent_count;
+        diskfs_backing_t* bk = (diskfs_backing_t*)my_malloc_tag(
+            sizeof(diskfs_backing_t) + count * sizeof(diskfs_extent_t), HEAP_TAG_FS);
+        if (!bk) {
+            vfs_unlink(node);
+            return NULL;
+        }
+        bk->count = count;
+        memcpy(bk->extents, ino->extents, count * sizeof(diskfs_extent_t));
+        node->ops = &diskfs_file_ops;
+        node->data.file.backing = bk;
+        node->data.file.size = ino->size;
+    }
+    node->dirty = false;
+    return node;
+}
+
+// One sweep over the inode table, a block at a time, loading every inode
+// whose parent is already in the tree. Sweeps repeat until nothing is left;
+// a sweep that loads nothing means orphans or a parent cycle.
+static bool load_tree(fs_node_t** nodes) {
+    bool pending = true;
+    while (pending) {
+        bool progress = false;
+        pending = false;
+        for (uint32_t b = 0; b < sb.inode_blocks; b++) {
+            if (!read_blocks(sb.inode_start + b, 1, block_buf)) return false;
+            const diskfs_inode_t* table = (const diskfs_inode_t*)block_buf;
+            for (uint32_t k = 0; k < INODES_PER_BLOCK; k++) {
+                uint32_t i = b * INODES_PER_BLOCK + k;
+                const diskfs_inode_t* ino = &table[k];
+                if (i == 0 || ino->type == INODE_FREE || nodes[i]) continue;
+                // Keep every used inode reserved, even one that fails to
+                // load, so a later sync cannot hand out its blocks
+                bit_set(inode_map, i, true);
+                fs_node_t* parent = ino->parent == 0 ? root_dir
+                                  : ino->parent < sb.inode_count ? nodes[ino->parent] : NULL;
+                if (!parent) {
+                    pending = true;
+                    continue;
+                }
+                nodes[i] = load_node(parent, ino);
+                if (!nodes[i]) return false;
+                nodes[i]->ino = i;
+                progress = true;
+            }
+        }
+        if (pending && !progress) return false;
+    }
+    return true;
+}
+
+// Undoes a partial load, children first so every folder is empty when
+// it is unlinked
+static void drop_loaded(fs_node_t** nodes) {
+    bool left = true;
+    while (left) {
+        left = false;
+        for (uint32_t i = 1; i < sb.inode_count; i++) {
+            fs_node_t* n = nodes[i];
+            if (!n) continue;
+            if (n->type == TYPE_FOLDER && n->data.folder.children) {
+                left = true;
+                continue;
+            }
+            vfs_unlink(n);
+            nodes[i] = NULL;
+        }
+    }
+}
+
+bool diskfs_mount(void) {
+    if (!disk) {
+        vga_puts("[X] No disk attached\n");
+        return false;
+    }
+    if (mounted) {
+        vga_puts("[X] Already mounted\n");
+        return false;
+    }
+    // Sync would delete on-disk files that a merged tree does not mention
+    if (root_dir->data.folder.children) {
+        vga_puts("[X] Mount needs an empty file system\n");
+        return false;
+    }
+
+    if (!read_blocks(0, 1, block_buf)) {
+        vga_puts("[X] Disk read failed\n");
+        return false;
+    }
+    memcpy(&sb, block_buf, sizeof(sb));
+    // The layout must be exactly what format writes: the maps are sized
+    // from these fields and indexed by block and inode numbers
+    if (sb.magic != DISKFS_MAGIC || sb.version != DISKFS_VERSION ||
+        sb.block_size != DISKFS_BLOCK_SIZE || disk->sectors < DISKFS_START_LBA ||
+        sb.total_blocks > (disk->sectors - DISKFS_START_LBA) / SECTORS_PER_BLOCK ||
+        sb.bitmap_start != 1 ||
+        sb.bitmap_blocks != (sb.total_blocks + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK ||
+        sb.inode_start != sb.bitmap_start + sb.bitmap_blocks ||
+        sb.inode_count < INODES_PER_BLOCK || sb.inode_count > INODES_MAX ||
+        sb.inode_count % INODES_PER_BLOCK ||
+        sb.inode_blocks != sb.inode_count / INODES_PER_BLOCK ||
+        sb.data_start != sb.inode_start + sb.inode_blocks || sb.data_start >= sb.total_blocks) {
+        vga_puts("[X] No file system on disk (use 'format')\n");
+        return false;
+    }
+
+    if (!alloc_maps()) return false;
+    fs_node_t** nodes = (fs_node_t**)my_malloc_tag(sb.inode_count * sizeof(fs_node_t*), HEAP_TAG_FS);
+    bool ok = nodes && read_blocks(sb.bitmap_start, sb.bitmap_blocks, block_map);
+    if (ok) {
+        memset(nodes, 0, sb.inode_count * sizeof(fs_node_t*));
+        free_blocks = 0;
+        for (uint32_t b = 0; b < sb.total_blocks; b++) {
+            if (!bit_test(block_map, b)) free_blocks++;
+        }
+        bit_set(inode_map, 0, true);
+        ok = load_tree(nodes);
+        if (!ok) drop_loaded(nodes);
+    }
+    my_free(nodes);
+
+    if (!ok) {
+        unmount();
+        vga_puts("[X] Could not load every file from disk\n");
+        return false;
+    }
+    mounted = true;
+    return true;
+}
+
+// --- sync ---------------------------------------------------------------------
+//
+// A sync runs in two phases split by a device flush, which is the only
+// ordering the block cache gives (bcache.h). First the changed file bodies
+// go to newly allocated blocks and the bitmap is written with those blocks
+// marked used. Then, after the flush, the inodes are pointed at the new
+// bodies. Blocks the inodes stop using are only marked free once a second
+// flush has made those inodes durable. A crash at any point leaves every
+// inode on disk pointing at intact data, and the bitmap on disk is never
+// missing a block that an inode still uses.
+
+// A file body written in the first phase, waiting for its inode
+typedef struct {
+    fs_node_t* node;
+    uint32_t extent_count;
+    diskfs_extent_t extents[DISKFS_EXTENTS];
+} staged_body_t;
+
+typedef struct {
+    uint8_t* live;          // inodes still claimed by a node
+    staged_body_t* bodies;
+    uint32_t count;         // bodies written so far
+    uint32_t next;          // next body whose inode gets written
+} sync_state_t;
+
+// Dirty files whose body is in RAM or in a boot module rather than on disk
+static bool needs_body(const fs_node_t* n) {
+    return n->type == TYPE_FILE && (n->dirty || !n->ino) && n->ops != &diskfs_file_ops;
+}
+
+static uint32_t count_bodies(const fs_node_t* dir) {
+    uint32_t count = 0;
+    for (const fs_node_t* n = dir->data.folder.children; n; n = n->next) {
+        if (needs_body(n)) count++;
+        if (n->type == TYPE_FOLDER) count += count_bodies(n);
+    }
+    return count;
+}
+
+static bool write_body(fs_node_t* n, staged_body_t* body) {
+    diskfs_inode_t ino;
+    uint32_t blocks = (uint32_t)((n->data.file.size + DISKFS_BLOCK_SIZE - 1) / DISKFS_BLOCK_SIZE);
+    if (!alloc_extents(blocks, &ino)) {
+        vga_printf("[X] Disk full writing %s\n", n->name->str);
+        return false;
+    }
+    size_t off = 0;
+    bool ok = true;
+    for (uint32_t e = 0; ok && e < ino.extent_count; e++) {
+        for (uint32_t b = 0; ok && b < ino.extents[e].count; b++) {
+            size_t got = fs_read(n, off, block_buf, DISKFS_BLOCK_SIZE);
+            memset(block_buf + got, 0, DISKFS_BLOCK_SIZE - got);
+            ok = write_blocks(ino.extents[e].start + b, 1, block_buf);
+            off += DISKFS_BLOCK_SIZE;
+        }
+    }
+    if (!ok) {
+        free_extents(ino.extents, ino.extent_count);
+        return false;
+    }
+    body->node = n;
+    body->extent_count = ino.extent_count;
+    memcpy(body->extents, ino.extents, ino.extent_count * sizeof(diskfs_extent_t));
+    return true;
+}
+
+// Points the node's inode at its new body, or at the unchanged one for a
+// file still on disk. The extents it replaces are released after the sync.
+static bool write_node(fs_node_t* n, const staged_body_t* body) {
+    diskfs_inode_t old;
+    if (!read_inode(n->ino, &old)) return false;
+
+    diskfs_inode_t ino;
+    memset(&ino, 0, sizeof(ino));
+    ino.type = n->type == TYPE_FILE ? INODE_FILE : INODE_FOLDER;
+    ino.name_len = (uint8_t)n->name->len;
+    memcpy(ino.name, n->name->str, n->name->len);
+    ino.parent = n->parent->ino;
+    ino.size = n->type == TYPE_FILE ? (uint32_t)n->data.file.size : 0;
+
+    if (body) {
+        ino.extent_count = (uint16_t)body->extent_count;
+        memcpy(ino.extents, body->extents, body->extent_count * sizeof(diskfs_extent_t));
+    } else if (n->type == TYPE_FILE) {
+        // Body unchanged on disk: only the inode itself is rewritten
+        diskfs_backing_t* bk = (diskfs_backing_t*)n->data.file.backing;
+        ino.extent_count = (uint16_t)bk->count;
+        memcpy(ino.extents, bk->extents, bk->count * sizeof(diskfs_extent_t));
+    }
+
+    if (!write_inode(n->ino, &ino)) return false;
+    if (body && old.type == INODE_FILE) defer_free(old.extents, old.extent_count);
+    n->dirty = false;
+    return true;
+}
+
+static uint32_t alloc_inode(void) {
+    for (uint32_t i = 1; i < sb.inode_count; i++) {
+        if (!bit_test(inode_map, i)) {
+            bit_set(inode_map, i, true);
+            return i;
+        }
+    }
+    return 0;
+}
+
+// First phase: gives new nodes an inode and writes the changed bodies
+static bool write_bodies(fs_node_t* dir, sync_state_t* st) {
+    for (fs_node_t* n = dir->data.folder.children; n; n = n->next) {
+        bool body = needs_body(n);
+        if (!n->ino) {
+            n->ino = alloc_inode();
+            if (!n->ino) {
+                vga_puts("[X] Out of inodes\n");
+                return false;
+            }
+            n->dirty = true;
+        }
+        bit_set(st->live, n->ino, true);
+        if (body && !write_body(n, &st->bodies[st->count++])) {
+            st->count--;
+            return false;
+        }
+        if (n->type == TYPE_FOLDER && !write_bodies(n, st)) return false;
+    }
+    return true;
+}
+
+// Second phase, in the same order. Parents are written before their
+// children so every parent has an inode.
+static bool write_inodes(fs_node_t* dir, sync_state_t* st) {
+    for (fs_node_t* n = dir->data.folder.children; n; n = n->next) {
+        const staged_body_t* body = needs_body(n) ? &st->bodies[st->next++] : NULL;
+        if (n->dirty && !write_node(n, body)) return false;
+        if (n->type == TYPE_FOLDER && !write_inodes(n, st)) return false;
+    }
+    return true;
+}
+
+// Inodes no node claims any more belong to deleted files and folders
+static bool clear_unused_inodes(const uint8_t* live) {
+    for (uint32_t i = 1; i < sb.inode_count; i++) {
+        if (!bit_test(inode_map, i) || bit_test(live, i)) continue;
+        diskfs_inode_t ino;
+        if (!read_inode(i, &ino)) return false;
+        if (ino.type == INODE_FILE) defer_free(ino.extents, ino.extent_count);
+        memset(&ino, 0, sizeof(ino));
+        if (!write_inode(i, &ino)) return false;
+        bit_set(inode_map, i, false);
+    }
+    return true;
+}
+
+bool diskfs_sync(void) {
+    if (!mounted) {
+        vga_puts("[X] No file system mounted\n");
+        return false;
+    }
+
+    sync_state_t st;
+    memset(&st, 0, sizeof(st));
+    uint32_t bodies = count_bodies(root_dir);
+    st.live = (uint8_t*)my_malloc_tag(sb.inode_count / 8, HEAP_TAG_FS);
+    st.bodies = bodies ? (staged_body_t*)my_malloc_tag(bodies * sizeof(staged_body_t), HEAP_TAG_FS)
+                       : NULL;
+    if (!st.live || (bodies && !st.bodies)) {
+        my_free(st.live);
+        my_free(st.bodies);
+        vga_puts("[X] Not enough memory to sync\n");
+        return false;
+    }
+    memset(st.live, 0, sb.inode_count / 8);
+    bit_set(st.live, 0, true);
+
+    bool ok = write_bodies(root_dir, &st) &&
+              write_blocks(sb.bitmap_start, sb.bitmap_blocks, block_map) && disk->flush(disk);
+    ok = ok && write_inodes(root_dir, &st) && clear_unused_inodes(st.live) && disk->flush(disk);
+    if (ok) {
+        release_freed();
+        ok = write_blocks(sb.bitmap_start, sb.bitmap_blocks, block_map) && disk->flush(disk);
+    }
+
+    // Bodies whose inode was never written are referenced by nothing
+    for (uint32_t i = 0; i < st.count; i++) {
+        if (st.bodies[i].node->dirty) free_extents(st.bodies[i].extents, st.bodies[i].extent_count);
+    }
+    my_free(st.live);
+    my_free(st.bodies);
+
+    if (!ok) {
+        vga_puts("[X] Sync failed\n");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,30 @@
+#ifndef DISKFS_H
+#define DISKFS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "blkdev.h"
+
+// Persistent store for the VFS. The in-memory tree stays authoritative:
+// mounting rebuilds it from disk with file bodies read on demand, and
+// syncing writes back only the nodes that changed.
+//
+// Layout, in 4 KiB blocks from DISKFS_START_LBA: superblock, free-block
+// bitmap, inode table, data. The first MiB is left to boot images.
+
+#define DISKFS_BLOCK_SIZE 4096
+#define DISKFS_START_LBA 2048
+
+// Disk the file system lives on; NULL detaches
+void diskfs_attach(blkdev_t* dev);
+blkdev_t* diskfs_device(void);
+
+// These report failures with an "[X]" line on the console
+bool diskfs_format(void);
+bool diskfs_mount(void);
+bool diskfs_sync(void);
+
+bool diskfs_mounted(void);
+uint32_t diskfs_free_blocks(void);
+uint32_t diskfs_total_blocks(void);
+
+#endif // DISKFS_H
@@ -0,0 +1,190 @@
+#include "fbcon.h"
+#include "io.h"
+#include "pci.h"
+#include "paging.h"
+
+// Bochs dispi interface (QEMU -vga std)
+#define VBE_DISPI_INDEX 0x1CE
+#define VBE_DISPI_DATA  0x1CF
+
+#define VBE_DISPI_ID     0
+#define VBE_DISPI_XRES   1
+#define VBE_DISPI_YRES   2
+#define VBE_DISPI_BPP    3
+#define VBE_DISPI_ENABLE 4
+
+#define VBE_DISPI_ID2         0xB0C2  // first version with LFB and 32 bpp
+#define VBE_DISPI_ENABLED     0x01
+#define VBE_DISPI_LFB_ENABLED 0x40
+
+#define VBE_PCI_VENDOR 0x1234
+#define VBE_PCI_DEVICE 0x1111
+#define VBE_LFB_DEFAULT 0xE0000000u
+
+#define FB_PITCH (FBCON_WIDTH * 4)
+#define FB_ROW_BYTES (FB_PITCH * FBCON_GLYPH_H)
+
+static uint32_t* fb = NULL;
+static const uint8_t* font = NULL;  // 256 glyphs, 32 bytes apart
+
+static const uint32_t palette[16] = {
+    0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+    0x555555, 0x5555FF, 0x55FF55, 0x55FFFF, 0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF,
+};
+
+// A glyph row is one byte of font bits. For a given attribute every possible
+// byte is expanded once into its 8 pixels, so drawing a row is a 32-byte copy.
+// A few attributes are kept, replaced least recently used first.
+#define GLYPH_CACHE_SLOTS 4
+
+typedef struct {
+    uint32_t rows[256][FBCON_GLYPH_W];
+    uint16_t attr;
+    uint32_t last_used;
+} glyph_cache_t;
+
+static glyph_cache_t glyph_cache[GLYPH_CACHE_SLOTS];
+static uint32_t glyph_clock = 0;
+
+static bool cursor_shown = false;
+static size_t cursor_row, cursor_col;
+
+static void dispi_write(uint16_t index, uint16_t value) {
+    outw(VBE_DISPI_INDEX, index);
+    outw(VBE_DISPI_DATA, value);
+}
+
+static uint16_t dispi_read(uint16_t index) {
+    outw(VBE_DISPI_INDEX, index);
+    return inw(VBE_DISPI_DATA);
+}
+
+static void glyph_cache_fill(glyph_cache_t* g, uint16_t attr) {
+    uint32_t fg = palette[attr & 0x0F];
+    uint32_t bg = palette[(attr >> 4) & 0x0F];
+    for (int bits = 0; bits < 256; bits++) {
+        for (int x = 0; x < FBCON_GLYPH_W; x++) {
+            g->rows[bits][x] = (bits & (0x80 >> x)) ? fg : bg;
+        }
+    }
+    g->attr = attr;
+}
+
+static glyph_cache_t* glyph_cache_get(uint16_t attr) {
+    glyph_cache_t* victim = &glyph_cache[0];
+    glyph_clock++;
+    for (int i = 0; i < GLYPH_CACHE_SLOTS; i++) {
+        glyph_cache_t* g = &glyph_cache[i];
+        if (g->attr == attr) {
+            g->last_used = glyph_clock;
+            return g;
+        }
+        if (g->last_used < victim->last_used) victim = g;
+    }
+    glyph_cache_fill(victim, attr);
+    victim->last_used = glyph_clock;
+    return victim;
+}
+
+static void set_mode(void) {
+    dispi_write(VBE_DISPI_ENABLE, 0);
+    dispi_write(VBE_DISPI_XRES, FBCON_WIDTH);
+    dispi_write(VBE_DISPI_YRES, FBCON_HEIGHT);
+    dispi_write(VBE_DISPI_BPP, 32);
+    dispi_write(VBE_DISPI_ENABLE, VBE_DISPI_ENABLED | VBE_DISPI_LFB_ENABLED);
+}
+
+bool fbcon_init(const uint8_t* glyphs) {
+    if (!glyphs) return false;
+    if (dispi_read(VBE_DISPI_ID) < VBE_DISPI_ID2) return false;
+
+    uint32_t lfb = VBE_LFB_DEFAULT;
+    pci_addr_t dev;
+    if (pci_find_device(VBE_PCI_VENDOR, VBE_PCI_DEVICE, &dev)) {
+        lfb = pci_bar_address(dev, 0);
+    }
+
+    set_mode();
+    if (dispi_read(VBE_DISPI_XRES) != FBCON_WIDTH || dispi_read(VBE_DISPI_BPP) != 32) {
+        dispi_write(VBE_DISPI_ENABLE, 0);
+        return false;
+    }
+
+    paging_map_range(lfb, FB_PITCH * FBCON_HEIGHT, PAGING_CACHE_WC);
+    fb = (uint32_t*)(uintptr_t)lfb;
+    font = glyphs;
+    for (int i = 0; i < GLYPH_CACHE_SLOTS; i++) glyph_cache[i].attr = 0xFFFF;
+    return true;
+}
+
+void fbcon_enable(void) {
+    if (fb) set_mode();
+    cursor_shown = false;
+}
+
+void fbcon_disable(void) {
+    if (fb) dispi_write(VBE_DISPI_ENABLE, 0);
+    cursor_shown = false;
+}
+
+size_t fbcon_cols(void) {
+    return FBCON_WIDTH / FBCON_GLYPH_W;
+}
+
+size_t fbcon_rows(void) {
+    return FBCON_HEIGHT / FBCON_GLYPH_H;
+}
+
+void fbcon_draw_cells(size_t row, size_t col, const uint16_t* cells, size_t count) {
+    uint32_t* base = fb + row * FBCON_GLYPH_H * FBCON_WIDTH + col * FBCON_GLYPH_W;
+    glyph_cache_t* g = NULL;
+
+    for (size_t i = 0; i < count; i++, base += FBCON_GLYPH_W) {
+        uint16_t attr = cells[i] >> 8;
+        if (!g || g->attr != attr) g = glyph_cache_get(attr);
+        const uint8_t* glyph = font + (cells[i] & 0xFF) * 32;
+
+        uint32_t* d = base;
+        for (int y = 0; y < FBCON_GLYPH_H; y++, d += FBCON_WIDTH) {
+            const uint32_t* s = g->rows[glyph[y]];
+            d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = s[3];
+            d[4] = s[4]; d[5] = s[5]; d[6] = s[6]; d[7] = s[7];
+        }
+    }
+}
+
+// Moves the text up by whole character rows in one forward copy; the rows
+// uncovered at the bottom are redrawn by the caller.
+void fbcon_scroll(size_t lines) {
+    size_t rows = fbcon_rows();
+    if (lines >= rows) return;
+    void* dst = fb;
+    const void* src = (const uint8_t*)fb + lines * FB_ROW_BYTES;
+    size_t count = (rows - lines) * FB_ROW_BYTES / 4;
+    __asm__ volatile ("cld; rep movsl"
+                      : "+D"(dst), "+S"(src), "+c"(count)
+                      :
+                      : "memory");
+}
+
+// The cursor is an inverted underline, so drawing it twice restores the cell.
+static void cursor_toggle(size_t row, size_t col) {
+    uint32_t* d = fb + ((row + 1) * FBCON_GLYPH_H - 2) * FBCON_WIDTH + col * FBCON_GLYPH_W;
+    for (int y = 0; y < 2; y++, d += FBCON_WIDTH) {
+        for (int x = 0; x < FBCON_GLYPH_W; x++) d[x] ^= 0x00FFFFFF;
+    }
+}
+
+void fbcon_show_cursor(size_t row, size_t col) {
+    if (cursor_shown) return;
+    cursor_toggle(row, col);
+    cursor_row = row;
+    cursor_col = col;
+    cursor_shown = true;
+}
+
+void fbcon_hide_cursor(void) {
+    if (!cursor_shown) return;
+    cursor_toggle(cursor_row, cursor_col);
+    cursor_shown = false;
+}
@@ -0,0 +1,27 @@
+#ifndef FBCON_H
+#define FBCON_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Text console drawn on a Bochs/QEMU VBE linear framebuffer (1024x768x32).
+// Cells are the same char | attribute << 8 words as VGA text memory; vga.c
+// owns the console state and calls in here from vga_flush.
+
+#define FBCON_WIDTH  1024
+#define FBCON_HEIGHT 768
+#define FBCON_GLYPH_W 8
+#define FBCON_GLYPH_H 16
+
+bool fbcon_init(const uint8_t* font);
+void fbcon_enable(void);
+void fbcon_disable(void);
+size_t fbcon_cols(void);
+size_t fbcon_rows(void);
+
+void fbcon_draw_cells(size_t row, size_t col, const uint16_t* cells, size_t count);
+void fbcon_scroll(size_t lines);
+void fbcon_show_cursor(size_t row, size_t col);
+void fbcon_hide_cursor(void);
+
+#endif // FBCON_H
@@ -1,19 +1,399 @@
 #include "heap.h"
+#include "mini_string.h"
+#include <stdbool.h>
+#include <stdint.h>
 
-#define HEAP_SIZE (1024*1024)
-static char heap[HEAP_SIZE];
-static size_t heap_ptr = 0;
+// Bootstrap arena; further memory comes from the registered heap source.
+#define HEAP_BOOT_SIZE (256*1024)
+#define HEAP_GROW_MIN (256*1024)
+#define HEAP_MAX_REQUEST ((size_t)-1 / 4)
+static char heap[HEAP_BOOT_SIZE];
+
+// Segregated-fit allocator with boundary tags.
+//
+// Every block starts with a two-word header (total size, owner tag) and ends
+// with a footer word repeating the size; the low bit of size marks the block
+// as used. Free blocks are kept in HEAP_CLASSES doubly linked lists: the first
+// HEAP_SMALL_CLASSES lists hold exactly one block size each (step HEAP_ALIGN),
+// the rest hold power-of-two ranges. A bitmap of non-empty lists lets small
+// requests find a block in O(1).
+
+#define HEAP_WORD          sizeof(size_t)
+#define HEAP_ALIGN         (2 * HEAP_WORD)
+#define HEAP_HDR           (2 * HEAP_WORD)
+#define HEAP_USED          ((size_t)1)
+#define HEAP_MIN_BLOCK     (6 * HEAP_WORD)
+#define HEAP_SMALL_CLASSES 32
+#define HEAP_CLASSES       64
+#define HEAP_SMALL_MAX     (HEAP_MIN_BLOCK + (HEAP_SMALL_CLASSES - 1) * HEAP_ALIGN)
+
+typedef struct free_block {
+    size_t header;
+    size_t tag;
+    struct free_block* next;
+    struct free_block* prev;
+} free_block_t;
+
+static free_block_t* free_lists[HEAP_CLASSES];
+static uint32_t free_map[HEAP_CLASSES / 32];
+static bool heap_ready = false;
+static heap_source_t heap_source = NULL;
+static char* last_epilogue = NULL;
+
+static heap_tag_stats_t tag_stats[HEAP_TAG_COUNT];
+// Tag peaks are reached at different times, so the heap-wide peak is
+// tracked on its own
+static size_t live_total = 0;
+static size_t peak_total = 0;
+static size_t heap_total = 0;
+static size_t heap_free_bytes = 0;
+
+static const char* const tag_names[HEAP_TAG_COUNT] = {
+    [HEAP_TAG_MISC] = "misc",
+    [HEAP_TAG_SLAB] = "slab",
+    [HEAP_TAG_FILE] = "file data",
+    [HEAP_TAG_XVR] = "xvr image",
+    [HEAP_TAG_ARENA] = "compiler",
+    [HEAP_TAG_FS] = "fs index",
+    [HEAP_TAG_NAMES] = "names",
+    [HEAP_TAG_CACHE] = "block cache",
+};
+
+static inline size_t block_size(const void* b) {
+    return *(const size_t*)b & ~HEAP_USED;
+}
+
+static inline bool block_used(const void* b) {
+    return *(const size_t*)b & HEAP_USED;
+}
+
+static inline void set_tags(void* b, size_t size, size_t used) {
+    *(size_t*)b = size | used;
+    *(size_t*)((char*)b + size - HEAP_WORD) = size | used;
+}
+
+static inline void* next_block(void* b) {
+    return (char*)b + block_size(b);
+}
+
+static inline void* prev_block(void* b) {
+    size_t prev_size = *(size_t*)((char*)b - HEAP_WORD) & ~HEAP_USED;
+    return (char*)b - prev_size;
+}
+
+static inline int fls32(size_t v) {
+    return 31 - __builtin_clz((unsigned int)v);
+}
+
+static int size_class(size_t size) {
+    if (size <= HEAP_SMALL_MAX) {
+        return (int)((size - HEAP_MIN_BLOCK) / HEAP_ALIGN);
+    }
+    int c = HEAP_SMALL_CLASSES + fls32(size) - fls32(HEAP_SMALL_MAX);
+    return c < HEAP_CLASSES ? c : HEAP_CLASSES - 1;
+}
+
+static void list_insert(free_block_t* b, size_t size) {
+    int c = size_class(size);
+    b->prev = NULL;
+    b->next = free_lists[c];
+    if (b->next) b->next->prev = b;
+    free_lists[c] = b;
+    free_map[c / 32] |= 1u << (c % 32);
+    heap_free_bytes += size;
+}
+
+static void list_remove(free_block_t* b, size_t size) {
+    int c = size_class(size);
+    if (b->prev) b->prev->next = b->next;
+    else free_lists[c] = b->next;
+    if (b->next) b->next->prev = b->prev;
+    if (!free_lists[c]) free_map[c / 32] &= ~(1u << (c % 32));
+    heap_free_bytes -= size;
+}
+
+// Returns the first non-empty class >= c, or -1.
+static int next_nonempty(int c) {
+    for (int w = c / 32; w < HEAP_CLASSES / 32; w++) {
+        uint32_t bits = free_map[w];
+        if (w == c / 32) bits &= ~0u << (c % 32);
+        if (bits) return w * 32 + __builtin_ctz(bits);
+    }
+    return -1;
+}
+
+static void release_block(void* b, size_t size) {
+    set_tags(b, size, 0);
+    list_insert((free_block_t*)b, size);
+}
+
+// Carves `size` bytes off the front of free block `b` (already unlinked).
+static char* place_block(void* b, size_t size) {
+    size_t total = block_size(b);
+    if (total - size >= HEAP_MIN_BLOCK) {
+        set_tags(b, size, HEAP_USED);
+        release_block((char*)b + size, total - size);
+    } else {
+        set_tags(b, total, HEAP_USED);
+    }
+    return (char*)b;
+}
+
+// Hands a raw memory range to the allocator. The range is framed by a used
+// prologue block and a zero-sized used epilogue header so coalescing never
+// walks off either end.
+void heap_add_region(void* start, size_t size) {
+    uintptr_t base = ((uintptr_t)start + HEAP_ALIGN - 1) & ~(uintptr_t)(HEAP_ALIGN - 1);
+    uintptr_t end = (uintptr_t)start + size;
+    if (end <= base || end - base < 2 * HEAP_ALIGN + HEAP_MIN_BLOCK) return;
+
+    size_t usable = (end - base - 2 * HEAP_ALIGN) & ~(HEAP_ALIGN - 1);
+    char* prologue = (char*)base;
+    set_tags(prologue, HEAP_ALIGN, HEAP_USED);
+
+    char* first = prologue + HEAP_ALIGN;
+    last_epilogue = first + usable;
+    *(size_t*)last_epilogue = 0 | HEAP_USED;
+    heap_total += usable;
+    release_block(first, usable);
+}
+
+void heap_set_source(heap_source_t source) {
+    heap_source = source;
+}
+
+static void heap_init(void) {
+    heap_ready = true;
+    heap_add_region(heap, HEAP_BOOT_SIZE);
+}
+
+static void block_free(char* b);
+
+// Pulls at least `need` more bytes from the heap source. A chunk that starts
+// right where the last region ended simply extends it: the old epilogue
+// becomes the header of a new free block that merges with its predecessor.
+static bool heap_grow(size_t need) {
+    if (!heap_source) return false;
+
+    size_t size = need + 2 * HEAP_ALIGN;
+    if (size < HEAP_GROW_MIN) size = HEAP_GROW_MIN;
+    char* chunk = (char*)heap_source(&size);
+    if (!chunk) return false;
+
+    if (last_epilogue && chunk == last_epilogue + HEAP_ALIGN) {
+        char* b = last_epilogue;
+        last_epilogue += size;
+        *(size_t*)last_epilogue = 0 | HEAP_USED;
+        heap_total += size;
+        set_tags(b, size, HEAP_USED);
+        block_free(b);
+    } else {
+        heap_add_region(chunk, size);
+    }
+    return true;
+}
+
+static size_t request_size(size_t size) {
+    if (size > HEAP_MAX_REQUEST) return 0;
+    size_t total = (size + HEAP_HDR + HEAP_WORD + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+    return total < HEAP_MIN_BLOCK ? HEAP_MIN_BLOCK : total;
+}
+
+// Finds and claims a block of at least `need` bytes. No accounting.
+static char* block_find(size_t need) {
+    int c = size_class(need);
+
+    // Large classes cover a range of sizes, so scan the list itself first.
+    if (need > HEAP_SMALL_MAX) {
+        for (free_block_t* b = free_lists[c]; b; b = b->next) {
+            size_t bs = block_size(b);
+            if (bs >= need) {
+                list_remove(b, bs);
+                return place_block(b, need);
+            }
+        }
+        c++;
+    }
+
+    c = c < HEAP_CLASSES ? next_nonempty(c) : -1;
+    if (c < 0) return 0;
+
+    free_block_t* b = free_lists[c];
+    list_remove(b, block_size(b));
+    return place_block(b, need);
+}
+
+static char* block_alloc(size_t need) {
+    if (!heap_ready) heap_init();
+    char* b = block_find(need);
+    if (!b && heap_grow(need)) b = block_find(need);
+    return b;
+}
+
+// Returns a used block to the free lists, merging with free neighbours.
+static void block_free(char* b) {
+    size_t size = block_size(b);
+
+    char* next = (char*)next_block(b);
+    if (!block_used(next)) {
+        size_t ns = block_size(next);
+        list_remove((free_block_t*)next, ns);
+        size += ns;
+    }
+
+    if (!block_used(b - HEAP_WORD)) {
+        char* prev = (char*)prev_block(b);
+        size_t ps = block_size(prev);
+        list_remove((free_block_t*)prev, ps);
+        b = prev;
+        size += ps;
+    }
+
+    release_block(b, size);
+}
+
+// Shrinks used block `b` to `need` bytes, freeing the tail if it's big enough.
+static void block_trim(char* b, size_t need) {
+    size_t have = block_size(b);
+    if (have - need >= HEAP_MIN_BLOCK) {
+        set_tags(b, need, HEAP_USED);
+        set_tags(b + need, have - need, HEAP_USED);
+        block_free(b + need);
+    }
+}
+
+static void account_alloc(char* b, heap_tag_t tag) {
+    heap_tag_stats_t* s = &tag_stats[tag];
+    ((size_t*)b)[1] = tag;
+    s->live_bytes += block_size(b);
+    s->alloc_bytes += block_size(b);
+    s->allocs++;
+    if (s->live_bytes > s->peak_bytes) s->peak_bytes = s->live_bytes;
+    live_total += block_size(b);
+    if (live_total > peak_total) peak_total = live_total;
+}
+
+static void account_free(char* b) {
+    heap_tag_stats_t* s = &tag_stats[((size_t*)b)[1]];
+    s->live_bytes -= block_size(b);
+    s->frees++;
+    live_total -= block_size(b);
+}
+
+void* my_malloc_tag(size_t size, heap_tag_t tag) {
+    size_t need = request_size(size);
+    if (!need) return 0;
+    char* b = block_alloc(need);
+    if (!b) return 0;
+    account_alloc(b, tag);
+    return b + HEAP_HDR;
+}
 
 void* my_malloc(size_t size) {
-    // Simple bump allocator - no free list management
-    if (heap_ptr + size > HEAP_SIZE) return 0;
-    void* ptr = &heap[heap_ptr];
-    heap_ptr += size;
-    return ptr;
+    return my_malloc_tag(size, HEAP_TAG_MISC);
 }
 
 void my_free(void* ptr) {
-    // In this simple implementation, we don't actually free memory
-    // A more complete implementation would manage a free list
-    (void)ptr; // Prevent unused parameter warning
+    if (!ptr) return;
+    char* b = (char*)ptr - HEAP_HDR;
+    account_free(b);
+    block_free(b);
+}
+
+void* my_realloc(void* ptr, size_t size) {
+    if (!ptr) return my_malloc(size);
+    if (size == 0) {
+        my_free(ptr);
+        return 0;
+    }
+
+    size_t need = request_size(size);
+    if (!need) return 0;
+
+    char* b = (char*)ptr - HEAP_HDR;
+    heap_tag_t tag = (heap_tag_t)((size_t*)b)[1];
+    size_t have = block_size(b);
+
+    // Grow in place by absorbing a free successor.
+    if (have < need) {
+        char* next = (char*)next_block(b);
+        if (!block_used(next) && have + block_size(next) >= need) {
+            size_t ns = block_size(next);
+            list_remove((free_block_t*)next, ns);
+            set_tags(b, have + ns, HEAP_USED);
+        }
+    }
+
+    if (block_size(b) >= need) {
+        block_trim(b, need);
+        heap_tag_stats_t* s = &tag_stats[tag];
+        s->live_bytes = s->live_bytes - have + block_size(b);
+        if (block_size(b) > have) s->alloc_bytes += block_size(b) - have;
+        if (s->live_bytes > s->peak_bytes) s->peak_bytes = s->live_bytes;
+        live_total = live_total - have + block_size(b);
+        if (live_total > peak_total) peak_total = live_total;
+        return ptr;
+    }
+
+    char* moved = (char*)my_malloc_tag(size, tag);
+    if (!moved) return 0;
+    memcpy(moved, ptr, have - HEAP_HDR - HEAP_WORD);
+    my_free(ptr);
+    return moved;
+}
+
+// Returns `size` bytes whose address is a multiple of `align` (a power of two).
+// The block is over-allocated and the leading slack handed back to the free
+// lists, so the result can be released with my_free like any other block.
+void* my_malloc_aligned(size_t size, size_t align, heap_tag_t tag) {
+    if (align <= HEAP_ALIGN) return my_malloc_tag(size, tag);
+
+    size_t need = request_size(size + align + HEAP_MIN_BLOCK);
+    if (!need) return 0;
+    char* b = block_alloc(need);
+    if (!b) return 0;
+
+    uintptr_t aligned = ((uintptr_t)b + HEAP_HDR + HEAP_MIN_BLOCK + align - 1) & ~(uintptr_t)(align - 1);
+    char* ab = (char*)aligned - HEAP_HDR;
+    size_t lead = (size_t)(ab - b);
+    size_t total = block_size(b);
+
+    set_tags(ab, total - lead, HEAP_USED);
+    set_tags(b, lead, HEAP_USED);
+    block_free(b);
+    block_trim(ab, request_size(size));
+
+    account_alloc(ab, tag);
+    return (void*)aligned;
+}
+
+void heap_get_stats(heap_stats_t* out) {
+    if (!heap_ready) heap_init();
+    out->total_bytes = heap_total;
+    out->free_bytes = heap_free_bytes;
+    out->largest_free = 0;
+    out->free_blocks = 0;
+    out->live_bytes = live_total;
+    out->peak_bytes = peak_total;
+
+    for (int c = 0; c < HEAP_CLASSES; c++) {
+        for (free_block_t* b = free_lists[c]; b; b = b->next) {
+            out->free_blocks++;
+            if (block_size(b) > out->largest_free) out->largest_free = block_size(b);
+        }
+    }
+    for (int t = 0; t < HEAP_TAG_COUNT; t++) {
+        out->tags[t] = tag_stats[t];
+    }
+}
+
+void heap_reset_peak(void) {
+    peak_total = live_total;
+    for (int t = 0; t < HEAP_TAG_COUNT; t++) {
+        tag_stats[t].peak_bytes = tag_stats[t].live_bytes;
+    }
+}
+
+const char* heap_tag_name(heap_tag_t tag) {
+    return tag < HEAP_TAG_COUNT ? tag_names[tag] : "?";
 }
@@ -2,7 +2,53 @@
 #define HEAP_H
 #include <stddef.h>
 
+// Owner tags for heap accounting (shown by `meminfo`)
+typedef enum {
+    HEAP_TAG_MISC,
+    HEAP_TAG_SLAB,
+    HEAP_TAG_FILE,
+    HEAP_TAG_XVR,
+    HEAP_TAG_ARENA,
+    HEAP_TAG_FS,
+    HEAP_TAG_NAMES,
+    HEAP_TAG_CACHE,
+    HEAP_TAG_COUNT
+} heap_tag_t;
+
+typedef struct {
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t alloc_bytes;  // cumulative, including in-place growth; wraps
+    size_t allocs;
+    size_t frees;
+} heap_tag_stats_t;
+
+typedef struct {
+    size_t total_bytes;
+    size_t free_bytes;
+    size_t largest_free;
+    size_t free_blocks;
+    size_t live_bytes;   // all tags together
+    size_t peak_bytes;   // high-water mark of live_bytes
+    heap_tag_stats_t tags[HEAP_TAG_COUNT];
+} heap_stats_t;
+
+// Supplies more memory when the heap runs dry. Gets the wanted size in
+// *size, returns the chunk and stores its real size, or returns NULL.
+typedef void* (*heap_source_t)(size_t* size);
+
 void* my_malloc(size_t size);
+void* my_malloc_tag(size_t size, heap_tag_t tag);
 void my_free(void* ptr);
+void* my_realloc(void* ptr, size_t size);
+void* my_malloc_aligned(size_t size, size_t align, heap_tag_t tag);
+void heap_add_region(void* start, size_t size);
+void heap_set_source(heap_source_t source);
+
+void heap_get_stats(heap_stats_t* out);
+// Restarts every peak at the current live bytes, so the next peak read
+// belongs to whatever runs in between
+void heap_reset_peak(void);
+const char* heap_tag_name(heap_tag_t tag);
 
 #endif // HEAP_H
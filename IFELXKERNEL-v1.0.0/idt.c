@@ -0,0 +1,132 @@
+#include "idt.h"
+#include "io.h"
+#include "vga.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#define IDT_ENTRIES 48
+#define KERNEL_CS 0x08
+#define IDT_GATE_INT32 0x8E  // present, ring 0, 32-bit interrupt gate
+
+#define PIC1_CMD  0x20
+#define PIC1_DATA 0x21
+#define PIC2_CMD  0xA0
+#define PIC2_DATA 0xA1
+#define PIC_EOI   0x20
+#define PIC_READ_ISR 0x0B
+
+typedef struct {
+    uint16_t offset_lo;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type;
+    uint16_t offset_hi;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) idt_ptr_t;
+
+extern void* isr_stub_table[IDT_ENTRIES];
+
+static idt_entry_t idt[IDT_ENTRIES] __attribute__((aligned(8)));
+static irq_handler_t irq_handlers[16];
+
+static const char* const exception_names[32] = {
+    "divide error", "debug", "NMI", "breakpoint", "overflow", "bound range",
+    "invalid opcode", "device not available", "double fault", "coprocessor overrun",
+    "invalid TSS", "segment not present", "stack fault", "general protection",
+    "page fault", "reserved", "x87 error", "alignment check", "machine check",
+    "SIMD error", "virtualization", "control protection", "reserved", "reserved",
+    "reserved", "reserved", "reserved", "reserved", "reserved", "reserved",
+    "security", "reserved",
+};
+
+static void idt_set_gate(int vector, void* handler) {
+    uint32_t addr = (uint32_t)(uintptr_t)handler;
+    idt[vector].offset_lo = addr & 0xFFFF;
+    idt[vector].selector = KERNEL_CS;
+    idt[vector].zero = 0;
+    idt[vector].type = IDT_GATE_INT32;
+    idt[vector].offset_hi = addr >> 16;
+}
+
+// ICW1-4: edge triggered, cascaded, IRQ 0-15 on vectors 32-47
+static void pic_remap(void) {
+    outb(PIC1_CMD, 0x11);  io_wait();
+    outb(PIC2_CMD, 0x11);  io_wait();
+    outb(PIC1_DATA, IRQ_BASE);     io_wait();
+    outb(PIC2_DATA, IRQ_BASE + 8); io_wait();
+    outb(PIC1_DATA, 0x04); io_wait();  // slave on IRQ2
+    outb(PIC2_DATA, 0x02); io_wait();
+    outb(PIC1_DATA, 0x01); io_wait();  // 8086 mode
+    outb(PIC2_DATA, 0x01); io_wait();
+    outb(PIC1_DATA, 0xFF);
+    outb(PIC2_DATA, 0xFF);
+}
+
+static void pic_unmask(int irq) {
+    if (irq >= 8) {
+        outb(PIC2_DATA, inb(PIC2_DATA) & ~(1 << (irq - 8)));
+        irq = 2;
+    }
+    outb(PIC1_DATA, inb(PIC1_DATA) & ~(1 << irq));
+}
+
+// IRQ 7 and 15 also fire spuriously; the in-service bit tells them apart.
+static bool pic_spurious(int irq) {
+    if (irq != 7 && irq != 15) return false;
+    uint16_t cmd = irq == 7 ? PIC1_CMD : PIC2_CMD;
+    outb(cmd, PIC_READ_ISR);
+    if (inb(cmd) & 0x80) return false;
+    // A spurious IRQ 15 was still a real IRQ 2 on the master
+    if (irq == 15) outb(PIC1_CMD, PIC_EOI);
+    return true;
+}
+
+void idt_init(void) {
+    for (int i = 0; i < IDT_ENTRIES; i++) {
+        idt_set_gate(i, isr_stub_table[i]);
+    }
+    idt_ptr_t ptr = { sizeof(idt) - 1, (uint32_t)(uintptr_t)idt };
+    __asm__ volatile ("lidt %0" : : "m"(ptr));
+    pic_remap();
+}
+
+void irq_install(int irq, irq_handler_t handler) {
+    uint32_t flags = irq_save();
+    irq_handlers[irq] = handler;
+    pic_unmask(irq);
+    irq_restore(flags);
+}
+
+static void exception_halt(interrupt_frame_t* frame) {
+    vga_setcolor(VGA_COLOR_WHITE, VGA_COLOR_RED);
+    vga_printf("\n[X] CPU exception %d (%s), error %d, eip %d\n",
+               (int)frame->vector, exception_names[frame->vector],
+               (int)frame->error, (int)frame->eip);
+    if (frame->vector == 14) {
+        uint32_t cr2;
+        __asm__ volatile ("mov %%cr2, %0" : "=r"(cr2));
+        vga_printf("[X] Fault address %d\n", (int)cr2);
+    }
+    vga_puts("[X] System halted\n");
+    for (;;) {
+        __asm__ volatile ("cli; hlt");
+    }
+}
+
+// Called from isr_common with interrupts disabled
+void interrupt_dispatch(interrupt_frame_t* frame) {
+    if (frame->vector < IRQ_BASE) {
+        exception_halt(frame);
+        return;
+    }
+
+    int irq = frame->vector - IRQ_BASE;
+    if (pic_spurious(irq)) return;
+    if (irq_handlers[irq]) irq_handlers[irq](frame);
+    if (irq >= 8) outb(PIC2_CMD, PIC_EOI);
+    outb(PIC1_CMD, PIC_EOI);
+}
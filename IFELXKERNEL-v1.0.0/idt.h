@@ -0,0 +1,54 @@
+#ifndef IDT_H
+#define IDT_H
+#include <stdint.h>
+
+// Register state pushed by the stubs in isr.asm (pushad, then vector and
+// error code, then what the CPU pushed).
+typedef struct {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    uint32_t vector;
+    uint32_t error;
+    uint32_t eip, cs, eflags;
+} interrupt_frame_t;
+
+typedef void (*irq_handler_t)(interrupt_frame_t* frame);
+
+#define IRQ_TIMER    0
+#define IRQ_KEYBOARD 1
+#define IRQ_COM1     4
+
+#define IRQ_BASE 32  // vector of IRQ 0 after remapping the PIC
+
+// Loads the IDT and remaps the PIC with every line masked. Interrupts stay
+// off until irq_enable().
+void idt_init(void);
+// Installs a handler for a PIC line and unmasks it
+void irq_install(int irq, irq_handler_t handler);
+
+static inline void irq_enable(void) {
+    __asm__ volatile ("sti");
+}
+
+static inline void irq_disable(void) {
+    __asm__ volatile ("cli");
+}
+
+// Saves EFLAGS and disables interrupts, for sections shared with a handler
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    if (flags & 0x200) __asm__ volatile ("sti" : : : "memory");
+}
+
+// Enables interrupts and halts until the next one. Call with interrupts
+// disabled after checking for work: sti only takes effect after hlt has
+// started, so a wakeup cannot slip in between.
+static inline void cpu_wait(void) {
+    __asm__ volatile ("sti; hlt" : : : "memory");
+}
+
+#endif // IDT_H
@@ -0,0 +1,4 @@
+int main() {
+    printf("Hello from the boot ramdisk");
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include "intern.h"
+#include "heap.h"
+#include "mini_string.h"
+#include <stdbool.h>
+
+#define INTERN_MIN 256
+
+// Each string is its own heap block with the reference count in front of
+// the handle, so it can go as soon as nobody uses it
+typedef struct {
+    uint32_t refs;
+    uint32_t size;      // bytes allocated, header included
+} entry_head_t;
+
+static const istr_t** table = NULL;
+static uint32_t table_cap = 0;
+static uint32_t table_count = 0;
+static size_t table_bytes = 0;
+
+static const struct {
+    uint32_t hash;
+    uint32_t len;
+    char str[1];
+} empty_str = { 2166136261u, 0, "" };
+
+const istr_t* const istr_empty = (const istr_t*)&empty_str;
+
+static inline entry_head_t* head_of(const istr_t* s) {
+    return (entry_head_t*)s - 1;
+}
+
+// FNV-1a
+uint32_t intern_hash(const char* s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static const istr_t** probe(const char* s, size_t len, uint32_t h) {
+    uint32_t mask = table_cap - 1;
+    for (uint32_t i = h & mask;; i = (i + 1) & mask) {
+        const istr_t* e = table[i];
+        if (!e) return &table[i];
+        if (e->hash == h && e->len == len && memcmp(e->str, s, len) == 0) return &table[i];
+    }
+}
+
+static bool grow(void) {
+    uint32_t cap = table_cap ? table_cap * 2 : INTERN_MIN;
+    const istr_t** bigger = (const istr_t**)my_malloc_tag(cap * sizeof(*bigger), HEAP_TAG_NAMES);
+    if (!bigger) return false;
+    memset(bigger, 0, cap * sizeof(*bigger));
+
+    for (uint32_t i = 0; i < table_cap; i++) {
+        const istr_t* e = table[i];
+        if (!e) continue;
+        uint32_t j = e->hash & (cap - 1);
+        while (bigger[j]) j = (j + 1) & (cap - 1);
+        bigger[j] = e;
+    }
+    my_free(table);
+    table = bigger;
+    table_cap = cap;
+    return true;
+}
+
+const istr_t* intern_find_n(const char* s, size_t len) {
+    if (len == 0) return istr_empty;
+    if (!table_count) return NULL;
+    return *probe(s, len, intern_hash(s, len));
+}
+
+const istr_t* intern_find(const char* s) {
+    return intern_find_n(s, strlen(s));
+}
+
+const istr_t* intern_n(const char* s, size_t len) {
+    if (len == 0) return istr_empty;
+    if ((table_count + 1) * 4 > table_cap * 3 && !grow()) return NULL;
+
+    uint32_t h = intern_hash(s, len);
+    const istr_t** slot = probe(s, len, h);
+    if (*slot) {
+        head_of(*slot)->refs++;
+        return *slot;
+    }
+
+    uint32_t size = (uint32_t)(sizeof(entry_head_t) + sizeof(istr_t) + len + 1);
+    entry_head_t* head = (entry_head_t*)my_malloc_tag(size, HEAP_TAG_NAMES);
+    if (!head) return NULL;
+    head->refs = 1;
+    head->size = size;
+    istr_t* e = (istr_t*)(head + 1);
+    e->hash = h;
+    e->len = (uint32_t)len;
+    memcpy(e->str, s, len);
+    e->str[len] = '\0';
+    *slot = e;
+    table_count++;
+    table_bytes += size;
+    return e;
+}
+
+const istr_t* intern(const char* s) {
+    return intern_n(s, strlen(s));
+}
+
+// Backward-shift deletion as in dirindex.c: later members of the probe run
+// move into the hole, so the table never needs tombstones.
+void intern_release(const istr_t* s) {
+    if (!s || s == istr_empty) return;
+    entry_head_t* head = head_of(s);
+    if (--head->refs) return;
+
+    uint32_t mask = table_cap - 1;
+    uint32_t hole = s->hash & mask;
+    while (table[hole] != s) hole = (hole + 1) & mask;
+    for (uint32_t i = (hole + 1) & mask; table[i]; i = (i + 1) & mask) {
+        uint32_t home = table[i]->hash & mask;
+        // Move the entry if its home is not in (hole, i]
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table[hole] = table[i];
+            hole = i;
+        }
+    }
+    table[hole] = NULL;
+    table_count--;
+    table_bytes -= head->size;
+    my_free(head);
+}
+
+size_t intern_count(void) {
+    return table_count;
+}
+
+size_t intern_bytes(void) {
+    return table_bytes;
+}
@@ -0,0 +1,31 @@
+#ifndef INTERN_H
+#define INTERN_H
+#include <stddef.h>
+#include <stdint.h>
+
+// Interned strings: one immutable copy per distinct string, so equal names
+// compare by pointer and carry their hash and length with them. intern()
+// hands out a counted reference; the copy is freed when the last holder
+// calls intern_release, so only names something still uses stay in memory.
+typedef struct istr {
+    uint32_t hash;
+    uint32_t len;
+    char str[];
+} istr_t;
+
+extern const istr_t* const istr_empty;
+
+uint32_t intern_hash(const char* s, size_t len);
+// New reference to the string; NULL only when out of memory
+const istr_t* intern(const char* s);
+const istr_t* intern_n(const char* s, size_t len);
+// Drops a reference taken by intern; NULL and istr_empty are ignored
+void intern_release(const istr_t* s);
+// Existing handle or NULL; never adds to the table or takes a reference
+const istr_t* intern_find(const char* s);
+const istr_t* intern_find_n(const char* s, size_t len);
+
+size_t intern_count(void);
+size_t intern_bytes(void);
+
+#endif // INTERN_H
@@ -4,14 +4,60 @@
 #include "vga.h"
 #include "keyboard.h"
 #include "commands.h"
+#include "heap.h"
+#include "multiboot.h"
+#include "pmm.h"
+#include "paging.h"
+#include "serial.h"
+#include "idt.h"
+#include "timer.h"
+#include "clock.h"
+#include "ata.h"
+#include "virtio_blk.h"
+#include "bcache.h"
+#include "diskfs.h"
+#include "ramdisk.h"
 
-void kernel_main(void) {
-    // Initialize hardware and display
+void kernel_main(uint32_t magic, const multiboot_info_t* mbi) {
+    // Initialize hardware and display; console output is mirrored to COM1
+    serial_init();
     vga_init();
+
+    // Let the heap grow into the RAM the bootloader reported
+    if (magic == MULTIBOOT_BOOTLOADER_MAGIC) {
+        pmm_init(mbi);
+        heap_set_source(pmm_heap_source);
+    }
+    paging_init();
+    vga_init_framebuffer();
+
+    // Keyboard and serial input arrive by interrupt from here on
+    idt_init();
+    timer_init(TIMER_DEFAULT_HZ);
+    keyboard_init();
+    serial_enable_irq();
+    irq_enable();
+    clock_init();
+    commands_init();
+    // Prefer a virtio disk (DMA, interrupt completion) over ATA PIO. Disk
+    // I/O goes through the block cache; idle time writes it back.
+    blkdev_t* disk = virtio_blk_init();
+    if (!disk) disk = ata_init();
+    diskfs_attach(bcache_wrap(disk));
+    keyboard_set_idle_hook(bcache_idle);
     vga_setcolor(VGA_COLOR_WHITE, VGA_COLOR_BLUE);
     vga_clear();
 
     vga_printf("IFELXOS\n");
+    // Files persist when a formatted disk is attached
+    if (diskfs_device() && diskfs_mount()) {
+        vga_printf("Mounted %s\n", diskfs_device()->name);
+    }
+    // Archives GRUB loaded as modules; files already on disk take priority
+    if (magic == MULTIBOOT_BOOTLOADER_MAGIC) {
+        int files = ramdisk_load_modules(mbi);
+        if (files > 0) vga_printf("Loaded %d files from the boot ramdisk\n", files);
+    }
     vga_printf("Type 'help' for commands\n\n");
     
     // Main command loop
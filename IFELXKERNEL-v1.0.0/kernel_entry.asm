@@ -1,14 +1,53 @@
+MBOOT_PAGE_ALIGN equ 1 << 0
+MBOOT_MEM_INFO   equ 1 << 1
+MBOOT_FLAGS      equ MBOOT_PAGE_ALIGN | MBOOT_MEM_INFO
+
+BOOT_STACK_SIZE  equ 32768
+
 section .multiboot
     align 4
     dd 0x1BADB002
-    dd 0
-    dd -(0x1BADB002)
+    dd MBOOT_FLAGS
+    dd -(0x1BADB002 + MBOOT_FLAGS)
+
+section .bss
+    alignb 4096
+    global stack_guard
+stack_guard:                ; unmapped by paging_init to catch stack overflow
+    resb 4096
+stack_bottom:
+    resb BOOT_STACK_SIZE
+stack_top:
+
+; Flat 4 GiB code and data segments. GRUB leaves GDTR pointing at memory we
+; may overwrite, and interrupt gates need a known code selector.
+section .data
+    align 8
+gdt:
+    dq 0                    ; null
+    dq 0x00CF9A000000FFFF   ; 0x08: code, ring 0
+    dq 0x00CF92000000FFFF   ; 0x10: data, ring 0
+gdt_end:
+gdt_desc:
+    dw gdt_end - gdt - 1
+    dd gdt
 
 section .text
     global start
 start:
-    mov esp, 0x90000
+    lgdt [gdt_desc]
+    jmp 0x08:.reload_cs
+.reload_cs:
+    mov cx, 0x10            ; eax/ebx still hold the multiboot values
+    mov ds, cx
+    mov es, cx
+    mov fs, cx
+    mov gs, cx
+    mov ss, cx
+    mov esp, stack_top
     extern kernel_main
+    push ebx                ; multiboot info pointer
+    push eax                ; bootloader magic
     call kernel_main
     cli
 .hang:
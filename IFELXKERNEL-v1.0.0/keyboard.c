@@ -1,14 +1,11 @@
 #include "keyboard.h"
 #include "vga.h"
+#include "io.h"
+#include "serial.h"
+#include "idt.h"
 #include <stdint.h>
 #include <stdbool.h>
 
-static inline uint8_t inb(uint16_t port) {
-    uint8_t ret;
-    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
-    return ret;
-}
-
 // scancode to ascii (US QWERTY), index = scancode, shift=0 or 1
 static const char scancode_table[2][128] = {
     // no shift
@@ -35,63 +32,125 @@ static const char scancode_table[2][128] = {
     }
 };
 
+// Scancodes from IRQ 1. The handler is the only writer of kb_head and the
+// main loop the only writer of kb_tail, so neither side needs a lock.
+#define KB_RING_SIZE 256  // power of two
+
+static volatile uint8_t kb_ring[KB_RING_SIZE];
+static volatile size_t kb_head = 0;
+static volatile size_t kb_tail = 0;
+
+static void keyboard_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    uint8_t sc = inb(0x60);
+    size_t next = (kb_head + 1) & (KB_RING_SIZE - 1);
+    if (next != kb_tail) {  // drop the key if the ring is full
+        kb_ring[kb_head] = sc;
+        __asm__ volatile ("" : : : "memory");
+        kb_head = next;
+    }
+}
+
+void keyboard_init(void) {
+    // Discard anything the controller buffered before the handler existed
+    while (inb(0x64) & 0x01) inb(0x60);
+    irq_install(IRQ_KEYBOARD, keyboard_irq);
+}
+
+static bool keyboard_pending(void) {
+    return kb_tail != kb_head;
+}
+
+static uint8_t keyboard_pop(void) {
+    uint8_t sc = kb_ring[kb_tail];
+    __asm__ volatile ("" : : : "memory");
+    kb_tail = (kb_tail + 1) & (KB_RING_SIZE - 1);
+    return sc;
+}
+
+// Tracks shift state and returns the character for a key press, or -1 for
+// releases and modifiers. Backspace and Enter come back as '\b' and '\n'.
+static int keyboard_translate(uint8_t sc) {
+    static bool shift = false;
+    
+    // Skip empty scancodes
+    if (sc == 0) return -1;
+    
+    // Check if key is pressed or released
+    bool key_pressed = !(sc & 0x80);
+    sc &= 0x7F; // Remove the release bit
+    
+    // Handle modifier keys
+    if (sc == 0x2A || sc == 0x36) {  // Left/Right Shift
+        shift = key_pressed;
+        return -1;
+    }
+    // Only process key press events for non-modifier keys
+    if (!key_pressed) return -1;
+
+    if (sc == 0x0E) return '\b';  // Backspace
+    if (sc == 0x1C) return '\n';  // Enter
+    return scancode_table[shift ? 1 : 0][sc];
+}
+
+// Returns the next typed character, or -1 if none is queued
+static int keyboard_poll(void) {
+    while (keyboard_pending()) {
+        int c = keyboard_translate(keyboard_pop());
+        if (c >= 0) return c;
+    }
+    return -1;
+}
+
+static void (*idle_hook)(void) = NULL;
+
+void keyboard_set_idle_hook(void (*hook)(void)) {
+    idle_hook = hook;
+}
+
 void keyboard_readline(char* buf, size_t maxlen) {
     if (!buf || maxlen == 0) return;
     
     size_t i = 0;
-    static bool shift = false;
+    // A serial terminal sends CR or CR LF for Enter
+    static bool last_cr = false;
     
     // Initialize buffer
     buf[0] = '\0';
     
     while (i + 1 < maxlen) {
-        // Wait for data to be available
-        while ((inb(0x64) & 0x01) == 0);
-        
-        uint8_t sc = inb(0x60);
-        
-        // Skip empty scancodes
-        if (sc == 0) continue;
-        
-        // Check if key is pressed or released
-        bool key_pressed = !(sc & 0x80);
-        sc &= 0x7F; // Remove the release bit
-        
-        // Handle modifier keys
-        switch (sc) {
-            case 0x2A:  // Left Shift
-            case 0x36:  // Right Shift
-                shift = key_pressed;
-                break;
-            default:
-                // Only process key press events for non-modifier keys
-                if (key_pressed) {
-                    // Handle special keys
-                    if (sc == 0x0E) {  // Backspace
-                        if (i > 0) {
-                            i--;
-                            vga_putc('\b');
-                            vga_putc(' ');
-                            vga_putc('\b');
-                            buf[i] = '\0';
-                        }
-                        continue;
-                    } else if (sc == 0x1C) {  // Enter
-                        vga_putc('\n');
-                        buf[i] = '\0';
-                        return;
-                    } else if (sc < 128) {  // Regular key
-                        if (i + 1 < maxlen) {  // Leave space for null terminator
-                            char c = scancode_table[shift ? 1 : 0][sc];
-                            if (c >= 32 && c <= 126) {  // Printable ASCII
-                                buf[i++] = c;
-                                buf[i] = '\0';  // Keep string null-terminated
-                                vga_putc(c);
-                            }
-                        }
-                    }
-                }
+        // Wait for a key from the keyboard or the serial line, draining
+        // queued serial output meanwhile
+        int c;
+        for (;;) {
+            if (idle_hook) idle_hook();
+            irq_disable();
+            if ((c = keyboard_poll()) >= 0 || (c = serial_getc()) >= 0) {
+                irq_enable();
                 break;
+            }
+            serial_flush();
+            cpu_wait();
+        }
+
+        bool after_cr = last_cr;
+        last_cr = (c == '\r');
+        if (c == '\n' && after_cr) continue;
+
+        if (c == '\b' || c == 0x7F) {  // Backspace
+            if (i > 0) {
+                i--;
+                vga_puts("\b \b");
+                buf[i] = '\0';
+            }
+        } else if (c == '\n' || c == '\r') {  // Enter
+            vga_putc('\n');
+            buf[i] = '\0';
+            return;
+        } else if (c >= 32 && c <= 126) {  // Printable ASCII
+            buf[i++] = (char)c;
+            buf[i] = '\0';  // Keep string null-terminated
+            vga_putc((char)c);
         }
     }
     
@@ -101,11 +160,25 @@ void keyboard_readline(char* buf, size_t maxlen) {
     return;
 }
 
+// Looks for an ESC press among the queued keys without disturbing the rest.
+// If there is one, it and everything typed before it are consumed; keys
+// typed after it stay queued for the shell.
 bool keyboard_check_esc(void) {
-    uint8_t status = inb(0x64);
-    if (status & 0x01) { // إذا كان هناك بيانات متاحة
-        uint8_t scancode = inb(0x60);
-        return (scancode == 0x01); // 0x01 هو scancode مفتاح ESC
+    for (size_t i = kb_tail; i != kb_head; i = (i + 1) & (KB_RING_SIZE - 1)) {
+        if (kb_ring[i] != 0x01) continue;
+        size_t end = (i + 1) & (KB_RING_SIZE - 1);
+        while (kb_tail != end) keyboard_translate(keyboard_pop());
+        return true;
     }
     return false;
 }
+
+// Sleeps until ESC is pressed
+void keyboard_wait_esc(void) {
+    for (;;) {
+        irq_disable();
+        if (keyboard_check_esc()) break;
+        cpu_wait();
+    }
+    irq_enable();
+}
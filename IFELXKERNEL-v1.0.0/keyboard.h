@@ -4,7 +4,12 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+void keyboard_init(void);
 void keyboard_readline(char* buf, size_t maxlen);
 bool keyboard_check_esc(void);
+void keyboard_wait_esc(void);
+// Called with interrupts enabled each time keyboard_readline wakes up
+// without input, for background work such as flushing disk writes
+void keyboard_set_idle_hook(void (*hook)(void));
 
 #endif
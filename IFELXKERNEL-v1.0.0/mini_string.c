@@ -29,7 +29,7 @@ char* strcpy(char* dest, const char* src) {
     return dest;
 }
 
-// Minimal vsnprintf: only supports %s and %d, no width/precision, no float
+// Minimal vsnprintf: only supports %s, %d, %x and %%, no width/precision, no float
 int vsnprintf(char* buf, size_t size, const char* fmt, __builtin_va_list args) {
     size_t i = 0;
     for (; *fmt && i + 1 < size; ++fmt) {
@@ -46,6 +46,14 @@ int vsnprintf(char* buf, size_t size, const char* fmt, __builtin_va_list args) {
                 do { tmp[n++] = '0' + (v % 10); v /= 10; } while (v && n < 15);
                 if (neg) tmp[n++] = '-';
                 while (n && i + 1 < size) buf[i++] = tmp[--n];
+            } else if (*fmt == 'x') {
+                unsigned int v = __builtin_va_arg(args, unsigned int);
+                char tmp[8];
+                int n = 0;
+                do { tmp[n++] = "0123456789abcdef"[v & 0xF]; v >>= 4; } while (v);
+                while (n && i + 1 < size) buf[i++] = tmp[--n];
+            } else if (*fmt == '%') {
+                buf[i++] = '%';
             } else {
                 buf[i++] = '%';
                 if (i + 1 < size) buf[i++] = *fmt;
@@ -71,3 +79,37 @@ char* strstr(const char* haystack, const char* needle) {
     }
     return NULL;
 }
+
+void* memcpy(void* dest, const void* src, size_t n) {
+    unsigned char* d = dest;
+    const unsigned char* s = src;
+    while (n--) *d++ = *s++;
+    return dest;
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+    unsigned char* d = dest;
+    const unsigned char* s = src;
+    if (d < s) {
+        while (n--) *d++ = *s++;
+    } else if (d > s) {
+        d += n; s += n;
+        while (n--) *--d = *--s;
+    }
+    return dest;
+}
+
+void* memset(void* dest, int c, size_t n) {
+    unsigned char* d = dest;
+    while (n--) *d++ = (unsigned char)c;
+    return dest;
+}
+
+int memcmp(const void* a, const void* b, size_t n) {
+    const unsigned char* x = a;
+    const unsigned char* y = b;
+    for (; n; --n, ++x, ++y) {
+        if (*x != *y) return *x - *y;
+    }
+    return 0;
+}
@@ -8,4 +8,8 @@ size_t strlen(const char* s);
 char* strcpy(char* dest, const char* src);
 int vsnprintf(char* buf, size_t size, const char* fmt, __builtin_va_list args);
 char* strstr(const char* haystack, const char* needle);
+void* memcpy(void* dest, const void* src, size_t n);
+void* memmove(void* dest, const void* src, size_t n);
+void* memset(void* dest, int c, size_t n);
+int memcmp(const void* a, const void* b, size_t n);
 #endif
@@ -0,0 +1,156 @@
+#include "paging.h"
+#include "cpu.h"
+#include "pmm.h"
+#include <stdbool.h>
+
+// Identity-mapped paging. RAM is covered with 4 MiB PSE pages; a large page
+// is split into a 4 KiB table only where finer control is needed (legacy VGA
+// memory, the boot stack guard page). Write-combining comes from PAT entry 1,
+// which paging_init reprograms from write-through to WC; without PAT the VGA
+// window falls back to a fixed-range MTRR.
+
+#define PG_PRESENT 0x001
+#define PG_WRITE   0x002
+#define PG_PWT     0x008
+#define PG_PCD     0x010
+#define PG_LARGE   0x080
+#define PG_PAT_4K  0x080
+#define PG_PAT_4M  0x1000
+#define PG_CACHE   (PG_PWT | PG_PCD)
+
+#define LARGE_PAGE_SIZE (4u << 20)
+#define TABLE_POOL 4
+
+#define CR0_WP 0x00010000
+#define CR0_NW 0x20000000
+#define CR0_CD 0x40000000
+#define CR0_PG 0x80000000
+#define CR4_PSE 0x00000010
+
+#define MSR_MTRR_CAP        0x0FE
+#define MSR_MTRR_FIX16K_A0  0x259
+#define MSR_MTRR_DEF_TYPE   0x2FF
+#define MSR_PAT             0x277
+
+// PAT with entry 1 switched from WT (0x04) to WC (0x01); others at reset value
+#define PAT_VALUE 0x0007040600070106ULL
+
+extern char stack_guard[];
+extern char kernel_end[];
+
+static uint32_t page_dir[1024] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t table_pool[TABLE_POOL][1024] __attribute__((aligned(PAGE_SIZE)));
+static int tables_used = 0;
+static bool have_pse = false;
+static bool have_pat = false;
+
+static uint32_t* alloc_table(void) {
+    if (tables_used < TABLE_POOL) return table_pool[tables_used++];
+    return (uint32_t*)pmm_alloc_frames(1);
+}
+
+static uint32_t cache_bits(paging_cache_t cache) {
+    switch (cache) {
+        // Without PAT, UC- (PCD only) lets a WC MTRR take effect
+        case PAGING_CACHE_WC: return have_pat ? PG_PWT : PG_PCD;
+        case PAGING_CACHE_UC: return PG_PCD | PG_PWT;
+        default: return 0;
+    }
+}
+
+// Returns the 4 KiB table covering `addr`, splitting a large page if needed.
+static uint32_t* table_for(uintptr_t addr) {
+    uint32_t* pde = &page_dir[addr >> 22];
+    if ((*pde & PG_PRESENT) && !(*pde & PG_LARGE)) {
+        return (uint32_t*)(*pde & ~0xFFFu);
+    }
+
+    uint32_t* table = alloc_table();
+    if (!table) return NULL;
+
+    uint32_t base = *pde & 0xFFC00000u;
+    uint32_t flags = *pde & (PG_PRESENT | PG_WRITE | PG_CACHE);
+    if (*pde & PG_PAT_4M) flags |= PG_PAT_4K;
+    for (int i = 0; i < 1024; i++) {
+        table[i] = (*pde & PG_PRESENT) ? (base + i * PAGE_SIZE) | flags : 0;
+    }
+    *pde = (uint32_t)(uintptr_t)table | PG_PRESENT | PG_WRITE;
+    return table;
+}
+
+void paging_map_range(uintptr_t phys, size_t size, paging_cache_t cache) {
+    uint64_t start = phys & ~(uintptr_t)(LARGE_PAGE_SIZE - 1);
+    uint64_t end = (uint64_t)phys + size;
+    for (uint64_t a = start; a < end; a += LARGE_PAGE_SIZE) {
+        uint32_t* pde = &page_dir[a >> 22];
+        if (*pde & PG_PRESENT) continue;
+
+        if (have_pse) {
+            *pde = (uint32_t)a | PG_PRESENT | PG_WRITE | PG_LARGE | cache_bits(cache);
+        } else {
+            uint32_t* table = alloc_table();
+            if (!table) return;
+            for (int i = 0; i < 1024; i++) {
+                table[i] = ((uint32_t)a + i * PAGE_SIZE) | PG_PRESENT | PG_WRITE | cache_bits(cache);
+            }
+            *pde = (uint32_t)(uintptr_t)table | PG_PRESENT | PG_WRITE;
+        }
+        invlpg((uintptr_t)a);
+    }
+}
+
+void paging_set_cache(uintptr_t addr, size_t size, paging_cache_t cache) {
+    for (uintptr_t a = addr & ~(uintptr_t)(PAGE_SIZE - 1); a < addr + size; a += PAGE_SIZE) {
+        uint32_t* table = table_for(a);
+        if (!table) return;
+        uint32_t* pte = &table[(a >> 12) & 0x3FF];
+        *pte = (*pte & ~(PG_CACHE | PG_PAT_4K)) | cache_bits(cache);
+        invlpg(a);
+    }
+}
+
+void paging_unmap_page(uintptr_t addr) {
+    uint32_t* table = table_for(addr);
+    if (!table) return;
+    table[(addr >> 12) & 0x3FF] = 0;
+    invlpg(addr);
+}
+
+// Marks 0xA0000-0xBFFFF write-combining in the fixed-range MTRR. Follows the
+// SDM update sequence: caches off, flush, MTRRs off, write, re-enable.
+static void mtrr_vga_wc(void) {
+    if (!(rdmsr(MSR_MTRR_CAP) & (1u << 8))) return;
+
+    uint32_t cr0 = read_cr0();
+    write_cr0((cr0 | CR0_CD) & ~CR0_NW);
+    wbinvd();
+    uint64_t def = rdmsr(MSR_MTRR_DEF_TYPE);
+    wrmsr(MSR_MTRR_DEF_TYPE, def & ~(1u << 11));
+    wrmsr(MSR_MTRR_FIX16K_A0, 0x0101010101010101ULL);
+    wrmsr(MSR_MTRR_DEF_TYPE, def | (1u << 11) | (1u << 10));
+    wbinvd();
+    write_cr0(cr0);
+}
+
+void paging_init(void) {
+    uint32_t features = cpuid_features();
+    have_pse = features & CPUID_FEAT_PSE;
+    have_pat = (features & CPUID_FEAT_PAT) && (features & CPUID_FEAT_MSR);
+
+    if (have_pse) write_cr4(read_cr4() | CR4_PSE);
+    if (have_pat) wrmsr(MSR_PAT, PAT_VALUE);
+
+    uint64_t top = pmm_highest_address();
+    if (top < (uintptr_t)kernel_end) top = (uintptr_t)kernel_end;
+    if (top > 0xFFC00000ULL) top = 0xFFC00000ULL;
+    paging_map_range(0, (size_t)top, PAGING_CACHE_WB);
+
+    // Legacy VGA graphics window and the text buffer
+    paging_set_cache(0xA0000, 0x20000, PAGING_CACHE_WC);
+    if (!have_pat && (features & CPUID_FEAT_MTRR)) mtrr_vga_wc();
+
+    paging_unmap_page((uintptr_t)stack_guard);
+
+    write_cr3((uint32_t)(uintptr_t)page_dir);
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+}
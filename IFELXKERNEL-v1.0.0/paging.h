@@ -0,0 +1,17 @@
+#ifndef PAGING_H
+#define PAGING_H
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    PAGING_CACHE_WB,
+    PAGING_CACHE_WC,
+    PAGING_CACHE_UC
+} paging_cache_t;
+
+void paging_init(void);
+void paging_map_range(uintptr_t phys, size_t size, paging_cache_t cache);
+void paging_set_cache(uintptr_t addr, size_t size, paging_cache_t cache);
+void paging_unmap_page(uintptr_t addr);
+
+#endif // PAGING_H
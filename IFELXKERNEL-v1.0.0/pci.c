@@ -0,0 +1,111 @@
+#include "pci.h"
+#include "io.h"
+
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA    0xCFC
+
+static inline uint32_t pci_config_address(pci_addr_t addr, uint8_t offset) {
+    return 0x80000000u | ((uint32_t)addr.bus << 16) | ((uint32_t)addr.dev << 11) |
+           ((uint32_t)addr.fn << 8) | (offset & 0xFC);
+}
+
+uint32_t pci_read32(pci_addr_t addr, uint8_t offset) {
+    outl(PCI_CONFIG_ADDRESS, pci_config_address(addr, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+void pci_write32(pci_addr_t addr, uint8_t offset, uint32_t value) {
+    outl(PCI_CONFIG_ADDRESS, pci_config_address(addr, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+uint16_t pci_read16(pci_addr_t addr, uint8_t offset) {
+    return (uint16_t)(pci_read32(addr, offset) >> ((offset & 2) * 8));
+}
+
+uint8_t pci_read8(pci_addr_t addr, uint8_t offset) {
+    return (uint8_t)(pci_read32(addr, offset) >> ((offset & 3) * 8));
+}
+
+static pci_device_t devices[PCI_MAX_DEVICES];
+static int device_count = -1;
+
+static void record(pci_addr_t a, uint32_t id) {
+    if (device_count == PCI_MAX_DEVICES) return;
+    pci_device_t* d = &devices[device_count++];
+    uint32_t class_reg = pci_read32(a, PCI_CLASS);
+    uint8_t irq = pci_read8(a, PCI_INTERRUPT);
+    d->addr = a;
+    d->vendor = (uint16_t)id;
+    d->device = (uint16_t)(id >> 16);
+    d->class_code = (uint8_t)(class_reg >> 24);
+    d->subclass = (uint8_t)(class_reg >> 16);
+    d->prog_if = (uint8_t)(class_reg >> 8);
+    // Firmware leaves 0 or 0xFF on functions with no interrupt routed
+    d->irq = (irq == 0 || irq > 15) ? PCI_IRQ_NONE : irq;
+}
+
+int pci_scan(void) {
+    if (device_count >= 0) return device_count;
+    device_count = 0;
+    for (int bus = 0; bus < 256; bus++) {
+        for (int dev = 0; dev < 32; dev++) {
+            pci_addr_t a = { (uint8_t)bus, (uint8_t)dev, 0 };
+            uint32_t id = pci_read32(a, PCI_VENDOR_ID);
+            if ((id & 0xFFFF) == 0xFFFF) continue;
+
+            // Only multi-function devices answer on functions 1-7
+            int fns = (pci_read32(a, PCI_HEADER_TYPE) & 0x00800000) ? 8 : 1;
+            for (int fn = 0; fn < fns; fn++) {
+                a.fn = (uint8_t)fn;
+                if (fn) id = pci_read32(a, PCI_VENDOR_ID);
+                if ((id & 0xFFFF) != 0xFFFF) record(a, id);
+            }
+        }
+    }
+    return device_count;
+}
+
+const pci_device_t* pci_device(int index) {
+    return (index >= 0 && index < pci_scan()) ? &devices[index] : NULL;
+}
+
+bool pci_find_device(uint16_t vendor, uint16_t device, pci_addr_t* out) {
+    for (int i = 0; i < pci_scan(); i++) {
+        if (devices[i].vendor == vendor && devices[i].device == device) {
+            *out = devices[i].addr;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t pci_bar_address(pci_addr_t addr, int bar) {
+    uint32_t v = pci_read32(addr, (uint8_t)(PCI_BAR0 + bar * 4));
+    return (v & 1) ? (v & ~0x3u) : (v & ~0xFu);
+}
+
+bool pci_bar_is_high(pci_addr_t addr, int bar) {
+    uint32_t v = pci_read32(addr, (uint8_t)(PCI_BAR0 + bar * 4));
+    if ((v & 1) || ((v >> 1) & 3) != 2 || bar == 5) return false;
+    return pci_read32(addr, (uint8_t)(PCI_BAR0 + (bar + 1) * 4)) != 0;
+}
+
+void pci_enable(pci_addr_t addr, uint16_t bits) {
+    // The status half of the register is write-1-to-clear: write it as 0
+    uint32_t cmd = pci_read32(addr, PCI_COMMAND) & 0xFFFF;
+    pci_write32(addr, PCI_COMMAND, cmd | bits);
+}
+
+uint8_t pci_find_capability(pci_addr_t addr, uint8_t id, uint8_t from) {
+    // Status bit 4: the device has a capability list
+    if (!(pci_read32(addr, PCI_COMMAND) & 0x00100000)) return 0;
+    uint8_t cap = from ? pci_read8(addr, (uint8_t)(from + 1)) : pci_read8(addr, PCI_CAP_PTR);
+    // The list is at most 48 entries long; the bound stops a looping list
+    for (int n = 0; cap >= 0x40 && n < 48; n++) {
+        cap &= 0xFC;
+        if (pci_read8(addr, cap) == id) return cap;
+        cap = pci_read8(addr, (uint8_t)(cap + 1));
+    }
+    return 0;
+}
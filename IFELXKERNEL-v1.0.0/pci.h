@@ -0,0 +1,65 @@
+#ifndef PCI_H
+#define PCI_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Configuration space access through the legacy 0xCF8/0xCFC mechanism.
+
+typedef struct {
+    uint8_t bus;
+    uint8_t dev;
+    uint8_t fn;
+} pci_addr_t;
+
+#define PCI_VENDOR_ID   0x00
+#define PCI_COMMAND     0x04
+#define PCI_CLASS       0x08
+#define PCI_HEADER_TYPE 0x0C
+#define PCI_BAR0        0x10
+#define PCI_CAP_PTR     0x34
+#define PCI_INTERRUPT   0x3C
+
+#define PCI_CMD_IO      0x0001
+#define PCI_CMD_MEMORY  0x0002
+#define PCI_CMD_MASTER  0x0004
+
+#define PCI_CAP_VENDOR  0x09
+
+#define PCI_IRQ_NONE    0xFF
+
+// One function found by pci_scan
+typedef struct {
+    pci_addr_t addr;
+    uint16_t vendor;
+    uint16_t device;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    uint8_t irq;        // PIC line from the firmware, PCI_IRQ_NONE if unrouted
+} pci_device_t;
+
+#define PCI_MAX_DEVICES 32
+
+uint32_t pci_read32(pci_addr_t addr, uint8_t offset);
+uint16_t pci_read16(pci_addr_t addr, uint8_t offset);
+uint8_t pci_read8(pci_addr_t addr, uint8_t offset);
+void pci_write32(pci_addr_t addr, uint8_t offset, uint32_t value);
+
+// Walks every bus once and records each function present; later calls
+// return the same table
+int pci_scan(void);
+const pci_device_t* pci_device(int index);
+bool pci_find_device(uint16_t vendor, uint16_t device, pci_addr_t* out);
+
+// Memory BAR base with the flag bits masked off
+uint32_t pci_bar_address(pci_addr_t addr, int bar);
+// True for a memory BAR that decodes above 4 GiB, out of reach here
+bool pci_bar_is_high(pci_addr_t addr, int bar);
+// Turns on the given PCI_CMD_* bits
+void pci_enable(pci_addr_t addr, uint16_t bits);
+// Config offset of the first capability `id` after `from` (0 = from the
+// start of the list), or 0
+uint8_t pci_find_capability(pci_addr_t addr, uint8_t id, uint8_t from);
+
+#endif // PCI_H
@@ -0,0 +1,180 @@
+#include "pmm.h"
+#include "mini_string.h"
+#include <stdbool.h>
+
+// Physical frame allocator: one bit per 4 KiB frame (1 = in use), built from
+// the multiboot memory map. Everything not reported as available RAM, the
+// first megabyte, the kernel image, boot modules and the bitmap itself start
+// out reserved.
+
+#define MAX_REGIONS 32
+#define ADDR_LIMIT 0x100000000ULL
+
+extern char kernel_end[];
+
+typedef struct {
+    uint64_t base;
+    uint64_t end;
+} mem_region_t;
+
+static mem_region_t regions[MAX_REGIONS];
+static int region_count = 0;
+
+static uint32_t* frame_bitmap = NULL;
+static size_t frame_count = 0;
+static size_t free_count = 0;
+static size_t search_hint = 0;
+
+static inline bool frame_used(size_t f) {
+    return frame_bitmap[f / 32] & (1u << (f % 32));
+}
+
+static inline void frame_mark(size_t f) {
+    if (!frame_used(f)) {
+        frame_bitmap[f / 32] |= 1u << (f % 32);
+        free_count--;
+    }
+}
+
+static inline void frame_unmark(size_t f) {
+    if (frame_used(f)) {
+        frame_bitmap[f / 32] &= ~(1u << (f % 32));
+        free_count++;
+    }
+}
+
+static void add_region(uint64_t base, uint64_t len) {
+    if (region_count == MAX_REGIONS || base >= ADDR_LIMIT) return;
+    uint64_t end = base + len;
+    if (end > ADDR_LIMIT) end = ADDR_LIMIT;
+    regions[region_count].base = base;
+    regions[region_count].end = end;
+    region_count++;
+}
+
+static void collect_regions(const multiboot_info_t* mbi) {
+    if (mbi->flags & MULTIBOOT_INFO_MEM_MAP) {
+        uintptr_t p = mbi->mmap_addr;
+        uintptr_t end = mbi->mmap_addr + mbi->mmap_length;
+        while (p < end) {
+            const multiboot_mmap_entry_t* e = (const multiboot_mmap_entry_t*)p;
+            if (e->type == MULTIBOOT_MEMORY_AVAILABLE) add_region(e->addr, e->len);
+            p += e->size + sizeof(e->size);
+        }
+    } else if (mbi->flags & MULTIBOOT_INFO_MEMORY) {
+        add_region(0x100000, (uint64_t)mbi->mem_upper * 1024);
+    }
+}
+
+// Marks [start, end) as used, widening to whole frames.
+static void reserve_range(uint64_t start, uint64_t end) {
+    size_t first = (size_t)(start / PAGE_SIZE);
+    uint64_t last = (end + PAGE_SIZE - 1) / PAGE_SIZE;
+    for (size_t f = first; f < last && f < frame_count; f++) frame_mark(f);
+}
+
+// Marks [start, end) as free, shrinking to whole frames.
+static void release_range(uint64_t start, uint64_t end) {
+    uint64_t first = (start + PAGE_SIZE - 1) / PAGE_SIZE;
+    size_t last = (size_t)(end / PAGE_SIZE);
+    for (size_t f = (size_t)first; f < last && f < frame_count; f++) frame_unmark(f);
+}
+
+void pmm_init(const multiboot_info_t* mbi) {
+    collect_regions(mbi);
+
+    uint64_t highest = 0;
+    for (int i = 0; i < region_count; i++) {
+        if (regions[i].end > highest) highest = regions[i].end;
+    }
+    frame_count = (size_t)(highest / PAGE_SIZE);
+    size_t bitmap_bytes = (frame_count + 31) / 32 * 4;
+
+    // Nothing the bootloader placed above the kernel may be overwritten.
+    uint64_t busy_end = (uintptr_t)kernel_end;
+    if (mbi->flags & MULTIBOOT_INFO_MODS) {
+        const multiboot_module_t* mods = (const multiboot_module_t*)mbi->mods_addr;
+        for (uint32_t i = 0; i < mbi->mods_count; i++) {
+            if (mods[i].mod_end > busy_end) busy_end = mods[i].mod_end;
+        }
+    }
+    busy_end = (busy_end + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+
+    for (int i = 0; i < region_count && !frame_bitmap; i++) {
+        uint64_t start = regions[i].base > busy_end ? regions[i].base : busy_end;
+        if (start + bitmap_bytes <= regions[i].end) frame_bitmap = (uint32_t*)(uintptr_t)start;
+    }
+    if (!frame_bitmap) {
+        frame_count = 0;
+        return;
+    }
+
+    memset(frame_bitmap, 0xFF, bitmap_bytes);
+    free_count = 0;
+    for (int i = 0; i < region_count; i++) {
+        release_range(regions[i].base, regions[i].end);
+    }
+
+    reserve_range(0, 0x100000);
+    reserve_range(0x100000, busy_end);
+    reserve_range((uintptr_t)frame_bitmap, (uintptr_t)frame_bitmap + bitmap_bytes);
+    search_hint = (size_t)(busy_end / PAGE_SIZE);
+}
+
+// Finds `count` contiguous free frames starting the scan at the last hit.
+uintptr_t pmm_alloc_frames(size_t count) {
+    if (!count || count > free_count) return 0;
+
+    size_t run = 0;
+    size_t start = 0;
+    for (size_t scanned = 0, f = search_hint; scanned < frame_count + count; scanned++, f++) {
+        // A full-word skip over the padded last word can overshoot the end
+        if (f >= frame_count) {
+            f = 0;
+            run = 0;
+        }
+        // Skip fully used words while not inside a run.
+        if (!run && f % 32 == 0 && frame_bitmap[f / 32] == 0xFFFFFFFF) {
+            f += 31;
+            scanned += 31;
+            continue;
+        }
+        if (frame_used(f)) {
+            run = 0;
+            continue;
+        }
+        if (!run) start = f;
+        if (++run == count) {
+            for (size_t i = start; i < start + count; i++) frame_mark(i);
+            search_hint = start + count;
+            return (uintptr_t)start * PAGE_SIZE;
+        }
+    }
+    return 0;
+}
+
+void pmm_free_frames(uintptr_t addr, size_t count) {
+    size_t first = addr / PAGE_SIZE;
+    for (size_t f = first; f < first + count && f < frame_count; f++) frame_unmark(f);
+    if (first < search_hint) search_hint = first;
+}
+
+size_t pmm_total_frames(void) {
+    return frame_count;
+}
+
+size_t pmm_free_frames_count(void) {
+    return free_count;
+}
+
+uint64_t pmm_highest_address(void) {
+    return (uint64_t)frame_count * PAGE_SIZE;
+}
+
+void* pmm_heap_source(size_t* size) {
+    size_t frames = (*size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uintptr_t addr = pmm_alloc_frames(frames);
+    if (!addr) return NULL;
+    *size = frames * PAGE_SIZE;
+    return (void*)addr;
+}
@@ -0,0 +1,19 @@
+#ifndef PMM_H
+#define PMM_H
+#include <stddef.h>
+#include <stdint.h>
+#include "multiboot.h"
+
+#define PAGE_SIZE 4096
+
+void pmm_init(const multiboot_info_t* mbi);
+uintptr_t pmm_alloc_frames(size_t count);
+void pmm_free_frames(uintptr_t addr, size_t count);
+size_t pmm_total_frames(void);
+size_t pmm_free_frames_count(void);
+uint64_t pmm_highest_address(void);
+
+// Heap source: hands the heap a contiguous run of frames covering *size bytes
+void* pmm_heap_source(size_t* size);
+
+#endif // PMM_H
@@ -0,0 +1,227 @@
+#include "ramdisk.h"
+#include "vfs.h"
+#include "mini_string.h"
+
+#define TAR_BLOCK 512
+
+// --- files backed by module memory ----------------------------------------
+
+static const vnode_ops_t ramdisk_file_ops;
+
+static size_t ramdisk_read(fs_node_t* file, size_t off, void* buf, size_t len) {
+    size_t size = file->data.file.size;
+    if (off >= size) return 0;
+    if (len > size - off) len = size - off;
+    memcpy(buf, (const char*)file->data.file.backing + off, len);
+    return len;
+}
+
+static void ramdisk_release(fs_node_t* node) {
+    // The module stays reserved for the life of the kernel; nothing to free
+    node->data.file.backing = NULL;
+    ramfs_ops.release(node);
+}
+
+// Copy on write: the body moves into chunks and the node becomes an
+// ordinary in-memory file
+static bool copy_up(fs_node_t* file, size_t keep) {
+    const void* image = file->data.file.backing;
+    size_t size = file->data.file.size;
+    file->ops = &ramfs_ops;
+    file->data.file.backing = NULL;
+    file->data.file.size = 0;
+    if (keep && !ramfs_ops.append(file, image, keep)) {
+        file->ops = &ramdisk_file_ops;
+        file->data.file.backing = (void*)image;
+        file->data.file.size = size;
+        return false;
+    }
+    return true;
+}
+
+static bool ramdisk_append(fs_node_t* file, const void* data, size_t len) {
+    return copy_up(file, file->data.file.size) && file->ops->append(file, data, len);
+}
+
+static bool ramdisk_truncate(fs_node_t* file, size_t size) {
+    // Shrinking copies only what survives
+    if (size <= file->data.file.size) return copy_up(file, size);
+    return copy_up(file, file->data.file.size) && file->ops->truncate(file, size);
+}
+
+static const vnode_ops_t ramdisk_file_ops = {
+    .release = ramdisk_release,
+    .read = ramdisk_read,
+    .append = ramdisk_append,
+    .truncate = ramdisk_truncate,
+};
+
+// --- archive walking --------------------------------------------------------
+
+// Creates the folders along `path` and returns the one that should hold
+// its last component, which is copied to `leaf`. NULL for unusable paths.
+static fs_node_t* make_parents(const char* path, size_t len, char* leaf) {
+    fs_node_t* dir = root_dir;
+    leaf[0] = '\0';
+    size_t i = 0;
+    while (i < len) {
+        while (i < len && path[i] == '/') i++;
+        size_t start = i;
+        while (i < len && path[i] != '/') i++;
+        size_t n = i - start;
+        if (n == 0 || (n == 1 && path[start] == '.')) continue;
+        if (n > VFS_NAME_MAX || (n == 2 && path[start] == '.' && path[start + 1] == '.')) {
+            return NULL;
+        }
+
+        if (leaf[0]) {
+            // The previous component was not the last: it is a folder
+            fs_node_t* next = vfs_lookup(dir, leaf);
+            if (!next) next = vfs_create(dir, leaf, TYPE_FOLDER);
+            if (!next || next->type != TYPE_FOLDER) return NULL;
+            dir = next;
+        }
+        memcpy(leaf, path + start, n);
+        leaf[n] = '\0';
+    }
+    return dir;
+}
+
+// Adds one archive entry; true if a new file appeared
+static bool add_entry(const char* path, size_t path_len, bool folder,
+                      const void* data, size_t size) {
+    char leaf[VFS_NAME_MAX + 1];
+    fs_node_t* dir = make_parents(path, path_len, leaf);
+    if (!dir || !leaf[0]) return false;
+
+    fs_node_t* node = vfs_lookup(dir, leaf);
+    if (folder) {
+        if (!node) vfs_create(dir, leaf, TYPE_FOLDER);
+        return false;
+    }
+    // A file already there (from disk, or an earlier module) wins
+    if (node) return false;
+    node = vfs_create(dir, leaf, TYPE_FILE);
+    if (!node) return false;
+    node->ops = &ramdisk_file_ops;
+    node->data.file.backing = (void*)data;
+    node->data.file.size = size;
+    return true;
+}
+
+static uint32_t parse_octal(const char* s, size_t n) {
+    uint32_t v = 0;
+    size_t i = 0;
+    while (i < n && s[i] == ' ') i++;
+    for (; i < n && s[i] >= '0' && s[i] <= '7'; i++) v = v * 8 + (uint32_t)(s[i] - '0');
+    return v;
+}
+
+static uint32_t parse_hex(const char* s) {
+    uint32_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        char c = s[i];
+        uint32_t d = (c >= '0' && c <= '9') ? (uint32_t)(c - '0')
+                   : (c >= 'a' && c <= 'f') ? (uint32_t)(c - 'a' + 10)
+                   : (c >= 'A' && c <= 'F') ? (uint32_t)(c - 'A' + 10) : 0;
+        v = v * 16 + d;
+    }
+    return v;
+}
+
+static size_t field_len(const char* s, size_t max) {
+    size_t n = 0;
+    while (n < max && s[n]) n++;
+    return n;
+}
+
+static int load_tar(const char* image, size_t size) {
+    int files = 0;
+    for (size_t off = 0; off + TAR_BLOCK <= size;) {
+        const char* h = image + off;
+        if (!h[0]) break;   // end-of-archive blocks are all zero
+        uint32_t body = parse_octal(h + 124, 12);
+        char type = h[156];
+        if (off + TAR_BLOCK + body > size) break;
+
+        // ustar splits long paths into prefix "/" name
+        char path[VFS_PATH_MAX];
+        size_t n = 0;
+        if (memcmp(h + 257, "ustar", 5) == 0 && h[345]) {
+            n = field_len(h + 345, 155);
+            memcpy(path, h + 345, n);
+            path[n++] = '/';
+        }
+        size_t name_len = field_len(h, 100);
+        memcpy(path + n, h, name_len);
+        n += name_len;
+
+        if (type == '0' || type == '\0' || type == '7') {
+            files += add_entry(path, n, false, h + TAR_BLOCK, body);
+        } else if (type == '5') {
+            add_entry(path, n, true, NULL, 0);
+        }
+        off += TAR_BLOCK + (body + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+    }
+    return files;
+}
+
+#define CPIO_HEADER 110
+#define CPIO_MODE_TYPE 0170000
+#define CPIO_MODE_DIR  0040000
+#define CPIO_MODE_FILE 0100000
+
+static int load_cpio(const char* image, size_t size) {
+    int files = 0;
+    for (size_t off = 0; off + CPIO_HEADER <= size;) {
+        const char* h = image + off;
+        if (memcmp(h, "07070", 5) != 0) break;
+        uint32_t mode = parse_hex(h + 14);
+        uint32_t body = parse_hex(h + 54);
+        uint32_t name_size = parse_hex(h + 94);    // includes the NUL
+        size_t data = (off + CPIO_HEADER + name_size + 3) & ~(size_t)3;
+        if (name_size == 0 || data + body > size) break;
+
+        const char* name = h + CPIO_HEADER;
+        size_t name_len = name_size - 1;
+        if (name_len == 10 && memcmp(name, "TRAILER!!!", 10) == 0) break;
+
+        if ((mode & CPIO_MODE_TYPE) == CPIO_MODE_FILE) {
+            files += add_entry(name, name_len, false, image + data, body);
+        } else if ((mode & CPIO_MODE_TYPE) == CPIO_MODE_DIR) {
+            add_entry(name, name_len, true, NULL, 0);
+        }
+        off = (data + body + 3) & ~(size_t)3;
+    }
+    return files;
+}
+
+int ramdisk_load(const void* image, size_t size) {
+    const char* p = (const char*)image;
+    if (size >= CPIO_HEADER && memcmp(p, "07070", 5) == 0 && (p[5] == '1' || p[5] == '2')) {
+        return load_cpio(p, size);
+    }
+    // Old-style tar has no magic; accept it when the checksum adds up
+    if (size >= TAR_BLOCK) {
+        uint32_t sum = 0;
+        for (int i = 0; i < TAR_BLOCK; i++) {
+            sum += (i >= 148 && i < 156) ? ' ' : (uint8_t)p[i];
+        }
+        if (sum == parse_octal(p + 148, 8) || memcmp(p + 257, "ustar", 5) == 0) {
+            return load_tar(p, size);
+        }
+    }
+    return -1;
+}
+
+int ramdisk_load_modules(const multiboot_info_t* mbi) {
+    if (!(mbi->flags & MULTIBOOT_INFO_MODS)) return 0;
+    const multiboot_module_t* mods = (const multiboot_module_t*)mbi->mods_addr;
+    int files = 0;
+    for (uint32_t i = 0; i < mbi->mods_count; i++) {
+        const void* image = (const void*)(uintptr_t)mods[i].mod_start;
+        int n = ramdisk_load(image, mods[i].mod_end - mods[i].mod_start);
+        if (n > 0) files += n;
+    }
+    return files;
+}
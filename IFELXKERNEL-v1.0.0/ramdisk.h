@@ -0,0 +1,19 @@
+#ifndef RAMDISK_H
+#define RAMDISK_H
+#include <stddef.h>
+#include "multiboot.h"
+
+// Boot archives (ustar or cpio "newc") loaded by GRUB as multiboot
+// modules. Their files join the VFS without being copied: reads come
+// straight from the module, and a file is copied into RAM chunks only
+// when it is first modified.
+
+// Adds the entries of one archive under the root; returns the number of
+// files added, or -1 if the data is not a supported archive. Paths that
+// already exist are left alone.
+int ramdisk_load(const void* image, size_t size);
+
+// Loads every module the bootloader passed; returns the files added
+int ramdisk_load_modules(const multiboot_info_t* mbi);
+
+#endif // RAMDISK_H
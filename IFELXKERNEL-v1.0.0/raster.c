@@ -0,0 +1,141 @@
+#include "raster.h"
+#include "vga.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define RW VGA_GFX_WIDTH
+#define RH VGA_GFX_HEIGHT
+
+// Line endpoints are clamped to this range so a stray VM value cannot turn
+// one line into billions of clipped steps.
+#define RASTER_COORD_LIMIT 8192
+
+static inline uint8_t* row_ptr(int y) {
+    return vga_backbuffer() + y * RW;
+}
+
+// Fills n bytes: a byte head up to 4-byte alignment, 32-bit stores for the
+// body, then the byte tail.
+static void span_fill(uint8_t* d, size_t n, uint8_t color) {
+    while (n && ((uintptr_t)d & 3)) {
+        *d++ = color;
+        n--;
+    }
+    uint32_t v = color * 0x01010101u;
+    uint32_t* w = (uint32_t*)d;
+    for (size_t i = 0; i < n / 4; i++) w[i] = v;
+    d += n & ~(size_t)3;
+    for (size_t i = 0; i < (n & 3); i++) d[i] = color;
+}
+
+// Same shape as span_fill; only the destination is aligned, the source
+// words are read unaligned, which x86 allows.
+static void span_copy(uint8_t* d, const uint8_t* s, size_t n) {
+    while (n && ((uintptr_t)d & 3)) {
+        *d++ = *s++;
+        n--;
+    }
+    uint32_t* w = (uint32_t*)d;
+    for (size_t i = 0; i < n / 4; i++) {
+        uint32_t v;
+        __builtin_memcpy(&v, s + i * 4, 4);
+        w[i] = v;
+    }
+    d += n & ~(size_t)3;
+    s += n & ~(size_t)3;
+    for (size_t i = 0; i < (n & 3); i++) d[i] = s[i];
+}
+
+void raster_clear(uint8_t color) {
+    span_fill(vga_backbuffer(), RW * RH, color);
+}
+
+void raster_fill_rect(int x, int y, int width, int height, uint8_t color) {
+    if (width <= 0 || height <= 0) return;
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x > RW - width ? RW : x + width;
+    int y1 = y > RH - height ? RH : y + height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    // Full-width rectangles are one contiguous span
+    if (x0 == 0 && x1 == RW) {
+        span_fill(row_ptr(y0), (size_t)(y1 - y0) * RW, color);
+        return;
+    }
+    uint8_t* d = row_ptr(y0) + x0;
+    for (int row = y0; row < y1; row++, d += RW) {
+        span_fill(d, x1 - x0, color);
+    }
+}
+
+static inline int clamp_coord(int v) {
+    if (v < -RASTER_COORD_LIMIT) return -RASTER_COORD_LIMIT;
+    if (v > RASTER_COORD_LIMIT) return RASTER_COORD_LIMIT;
+    return v;
+}
+
+void raster_line(int x0, int y0, int x1, int y1, uint8_t color) {
+    x0 = clamp_coord(x0); y0 = clamp_coord(y0);
+    x1 = clamp_coord(x1); y1 = clamp_coord(y1);
+
+    if (y0 == y1) {
+        if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+        raster_fill_rect(x0, y0, x1 - x0 + 1, 1, color);
+        return;
+    }
+    if (x0 == x1) {
+        if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+        raster_fill_rect(x0, y0, 1, y1 - y0 + 1, color);
+        return;
+    }
+
+    // Bounding box entirely off screen
+    if ((x0 < 0 && x1 < 0) || (x0 >= RW && x1 >= RW) ||
+        (y0 < 0 && y1 < 0) || (y0 >= RH && y1 >= RH)) {
+        return;
+    }
+
+    // Integer Bresenham; the pixel pointer moves by one byte or one row
+    int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+    int dy = y1 > y0 ? y1 - y0 : y0 - y1;
+    int sx = x1 > x0 ? 1 : -1;
+    int sy = y1 > y0 ? 1 : -1;
+    int err = dx - dy;
+    int x = x0, y = y0;
+
+    for (;;) {
+        if ((unsigned)x < RW && (unsigned)y < RH) {
+            row_ptr(y)[x] = color;
+        }
+        if (x == x1 && y == y1) break;
+        int e2 = err * 2;
+        if (e2 > -dy) { err -= dy; x += sx; }
+        if (e2 < dx)  { err += dx; y += sy; }
+    }
+}
+
+void raster_blit(const uint8_t* src, int width, int height, int pitch,
+                 int x, int y, int key) {
+    if (!src || width <= 0 || height <= 0) return;
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x > RW - width ? RW : x + width;
+    int y1 = y > RH - height ? RH : y + height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    const uint8_t* s = src + (y0 - y) * pitch + (x0 - x);
+    uint8_t* d = row_ptr(y0) + x0;
+    int n = x1 - x0;
+
+    for (int row = y0; row < y1; row++, s += pitch, d += RW) {
+        if (key == RASTER_NO_KEY) {
+            span_copy(d, s, n);
+            continue;
+        }
+        uint8_t k = (uint8_t)key;
+        for (int i = 0; i < n; i++) {
+            if (s[i] != k) d[i] = s[i];
+        }
+    }
+}
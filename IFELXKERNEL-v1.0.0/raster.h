@@ -0,0 +1,19 @@
+#ifndef RASTER_H
+#define RASTER_H
+#include <stdint.h>
+
+// Drawing primitives for the 320x200x256 back buffer. Everything is clipped
+// to the screen; nothing reaches VGA memory until vga_present().
+
+// Passed as the color key to copy every source pixel
+#define RASTER_NO_KEY (-1)
+
+void raster_clear(uint8_t color);
+void raster_fill_rect(int x, int y, int width, int height, uint8_t color);
+void raster_line(int x0, int y0, int x1, int y1, uint8_t color);
+// Copies a width x height 8-bit bitmap with rows `pitch` bytes apart.
+// Source pixels equal to `key` are skipped unless key is RASTER_NO_KEY.
+void raster_blit(const uint8_t* src, int width, int height, int pitch,
+                 int x, int y, int key);
+
+#endif // RASTER_H
@@ -0,0 +1,148 @@
+#include "serial.h"
+#include "io.h"
+#include "idt.h"
+#include <stdint.h>
+
+#define COM1 0x3F8
+
+#define UART_DATA 0  // RBR / THR, divisor low with DLAB
+#define UART_IER  1  // divisor high with DLAB
+#define UART_FCR  2  // IIR when read
+#define UART_LCR  3
+#define UART_MCR  4
+#define UART_LSR  5
+#define UART_SCR  7
+
+#define IER_RX_AVAIL  0x01
+#define IER_THR_EMPTY 0x02
+
+#define IIR_NO_INT    0x01
+#define IIR_ID_MASK   0x0E
+#define IIR_THR_EMPTY 0x02
+#define IIR_RX_AVAIL  0x04
+#define IIR_LINE      0x06
+#define IIR_RX_TIMEOUT 0x0C
+
+#define LSR_DATA_READY 0x01
+#define LSR_THR_EMPTY  0x20
+
+#define UART_FIFO_SIZE 16
+#define SERIAL_TX_RING 4096  // power of two
+#define SERIAL_RX_RING 256   // power of two
+
+static char tx_ring[SERIAL_TX_RING];
+static volatile size_t tx_head = 0;  // next byte to send
+static volatile size_t tx_tail = 0;  // next free slot
+static bool present = false;
+
+// Filled by the IRQ 4 handler, drained by serial_getc
+static volatile char rx_ring[SERIAL_RX_RING];
+static volatile size_t rx_head = 0;
+static volatile size_t rx_tail = 0;
+static bool irq_driven = false;
+
+bool serial_init(void) {
+    // The scratch register only holds a value if a UART is there
+    outb(COM1 + UART_SCR, 0x5A);
+    if (inb(COM1 + UART_SCR) != 0x5A) return false;
+
+    outb(COM1 + UART_IER, 0x00);
+    outb(COM1 + UART_LCR, 0x80);  // DLAB on
+    outb(COM1 + UART_DATA, 0x01); // divisor 1: 115200 baud
+    outb(COM1 + UART_IER, 0x00);
+    outb(COM1 + UART_LCR, 0x03);  // 8N1, DLAB off
+    outb(COM1 + UART_FCR, 0xC7);  // enable and clear FIFOs, 14-byte RX trigger
+    outb(COM1 + UART_MCR, 0x0B);  // DTR, RTS, OUT2
+
+    present = true;
+    return true;
+}
+
+bool serial_present(void) {
+    return present;
+}
+
+// THR-empty means the whole FIFO is free, so it takes a full load unchecked.
+// Both the IRQ handler and serial_flush call this; the latter with
+// interrupts off.
+static void serial_push_fifo(void) {
+    for (int n = 0; n < UART_FIFO_SIZE && tx_head != tx_tail; n++) {
+        outb(COM1 + UART_DATA, tx_ring[tx_head]);
+        tx_head = (tx_head + 1) & (SERIAL_TX_RING - 1);
+    }
+}
+
+void serial_flush(void) {
+    if (!present || tx_head == tx_tail) return;
+    uint32_t flags = irq_save();
+    if (inb(COM1 + UART_LSR) & LSR_THR_EMPTY) serial_push_fifo();
+    irq_restore(flags);
+}
+
+static void serial_enqueue(char c) {
+    size_t next = (tx_tail + 1) & (SERIAL_TX_RING - 1);
+    // Ring full: the FIFO drains a load at a time, by interrupt or here
+    while (next == tx_head) {
+        serial_flush();
+    }
+    tx_ring[tx_tail] = c;
+    tx_tail = next;
+}
+
+void serial_putc(char c) {
+    if (!present) return;
+    if (c == '\n') serial_enqueue('\r');
+    serial_enqueue(c);
+}
+
+void serial_write(const char* buf, size_t len) {
+    for (size_t i = 0; i < len; i++) serial_putc(buf[i]);
+}
+
+int serial_getc(void) {
+    if (!present) return -1;
+    if (irq_driven) {
+        if (rx_tail == rx_head) return -1;
+        int c = (uint8_t)rx_ring[rx_tail];
+        rx_tail = (rx_tail + 1) & (SERIAL_RX_RING - 1);
+        return c;
+    }
+    if (!(inb(COM1 + UART_LSR) & LSR_DATA_READY)) return -1;
+    return inb(COM1 + UART_DATA);
+}
+
+static void serial_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    uint8_t iir;
+    while (!((iir = inb(COM1 + UART_FCR)) & IIR_NO_INT)) {
+        switch (iir & IIR_ID_MASK) {
+            case IIR_RX_AVAIL:
+            case IIR_RX_TIMEOUT:
+                while (inb(COM1 + UART_LSR) & LSR_DATA_READY) {
+                    char c = inb(COM1 + UART_DATA);
+                    size_t next = (rx_head + 1) & (SERIAL_RX_RING - 1);
+                    if (next != rx_tail) {
+                        rx_ring[rx_head] = c;
+                        rx_head = next;
+                    }
+                }
+                break;
+            case IIR_THR_EMPTY:
+                serial_push_fifo();
+                break;
+            case IIR_LINE:
+                (void)inb(COM1 + UART_LSR);
+                break;
+            default:
+                (void)inb(COM1 + 6);  // modem status
+                break;
+        }
+    }
+}
+
+void serial_enable_irq(void) {
+    if (!present) return;
+    irq_install(IRQ_COM1, serial_irq);
+    irq_driven = true;
+    outb(COM1 + UART_IER, IER_RX_AVAIL | IER_THR_EMPTY);
+}
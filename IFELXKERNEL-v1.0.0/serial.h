@@ -0,0 +1,22 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+#include <stdbool.h>
+#include <stddef.h>
+
+// 16550 UART on COM1, 115200 8N1. Output is queued in a ring and pushed to
+// the 16-byte transmit FIFO a FIFO-load at a time, so writers never wait on
+// the line status per byte.
+
+bool serial_init(void);
+// Switches to IRQ 4: received bytes are queued and the transmit ring is
+// refilled into the FIFO each time it empties. Needs idt_init first.
+void serial_enable_irq(void);
+bool serial_present(void);
+void serial_putc(char c);
+void serial_write(const char* buf, size_t len);
+// Moves queued bytes into the FIFO if it has room; never waits
+void serial_flush(void);
+// Returns the next received byte, or -1 if none is waiting
+int serial_getc(void);
+
+#endif // SERIAL_H
@@ -0,0 +1,119 @@
+#include "shell.h"
+#include "vga.h"
+#include "mini_string.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHELL_MAX_COMMANDS 64
+#define SHELL_HASH_SLOTS 128  // power of two, at most half full
+#define SHELL_NAME_MAX 32
+
+// Commands in registration order, for help
+static const shell_command_t* commands[SHELL_MAX_COMMANDS];
+static int command_count = 0;
+
+// Open-addressing index over `commands`; each slot caches the name hash
+typedef struct {
+    uint32_t hash;
+    const shell_command_t* cmd;
+} shell_slot_t;
+
+static shell_slot_t slots[SHELL_HASH_SLOTS];
+
+// FNV-1a over the first len bytes
+static uint32_t name_hash(const char* s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static const shell_command_t* lookup(const char* name, size_t len) {
+    if (len == 0 || len >= SHELL_NAME_MAX) return NULL;
+    uint32_t h = name_hash(name, len);
+    for (uint32_t i = h;; i++) {
+        shell_slot_t* s = &slots[i & (SHELL_HASH_SLOTS - 1)];
+        if (!s->cmd) return NULL;
+        if (s->hash == h && strncmp(s->cmd->name, name, len) == 0 && s->cmd->name[len] == '\0') {
+            return s->cmd;
+        }
+    }
+}
+
+void shell_register(const shell_command_t* cmds, int count) {
+    for (int n = 0; n < count; n++) {
+        const shell_command_t* c = &cmds[n];
+        size_t len = strlen(c->name);
+        if (command_count == SHELL_MAX_COMMANDS || len >= SHELL_NAME_MAX ||
+            lookup(c->name, len)) {
+            vga_printf("[X] Cannot register command '%s'\n", c->name);
+            continue;
+        }
+        commands[command_count++] = c;
+
+        uint32_t h = name_hash(c->name, len);
+        uint32_t i = h;
+        while (slots[i & (SHELL_HASH_SLOTS - 1)].cmd) i++;
+        slots[i & (SHELL_HASH_SLOTS - 1)].hash = h;
+        slots[i & (SHELL_HASH_SLOTS - 1)].cmd = c;
+    }
+}
+
+// A line is matched as "name=arg", then as a bare "name", then as
+// "name rest" on its first word. Each try is one hash lookup.
+bool shell_dispatch(const char* line) {
+    size_t len = strlen(line);
+    while (len && (line[len - 1] == ' ' || line[len - 1] == '\t')) len--;
+    if (len == 0) return false;
+
+    const char* eq = NULL;
+    for (size_t i = 0; i < len; i++) {
+        if (line[i] == '=') { eq = line + i; break; }
+    }
+    if (eq) {
+        const shell_command_t* c = lookup(line, eq - line);
+        if (c && c->kind == SHELL_ARG_EQ) {
+            c->handler(eq + 1);
+            return true;
+        }
+    }
+
+    const shell_command_t* c = lookup(line, len);
+    if (c && c->kind == SHELL_ARG_NONE) {
+        c->handler("");
+        return true;
+    }
+
+    size_t word = 0;
+    while (word < len && line[word] != ' ') word++;
+    if (word < len) {
+        c = lookup(line, word);
+        if (c && c->kind == SHELL_ARG_REST) {
+            const char* rest = line + word;
+            while (*rest == ' ') rest++;
+            c->handler(rest);
+            return true;
+        }
+    }
+    return false;
+}
+
+void shell_print_help(void) {
+    vga_puts("Available commands:\n");
+    for (int i = 0; i < command_count; i++) {
+        const shell_command_t* c = commands[i];
+        switch (c->kind) {
+            case SHELL_ARG_EQ:
+                vga_printf("%s=<%s> - %s\n", c->name, c->arg, c->help);
+                break;
+            case SHELL_ARG_REST:
+                vga_printf("%s <%s> - %s\n", c->name, c->arg, c->help);
+                break;
+            default:
+                vga_printf("%s - %s\n", c->name, c->help);
+                break;
+        }
+    }
+}
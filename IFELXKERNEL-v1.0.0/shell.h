@@ -0,0 +1,27 @@
+#ifndef SHELL_H
+#define SHELL_H
+#include <stdbool.h>
+
+// Command registry. Subsystems register tables of commands at startup;
+// dispatch is a hash lookup on the command name instead of a strcmp chain.
+
+typedef enum {
+    SHELL_ARG_NONE,  // "ls"
+    SHELL_ARG_EQ,    // "run=<name>": the argument follows '='
+    SHELL_ARG_REST   // "time <command>": the argument is the rest of the line
+} shell_arg_t;
+
+typedef struct {
+    const char* name;      // may contain spaces: "add txt", "open folder"
+    shell_arg_t kind;
+    const char* arg;       // placeholder shown in help, e.g. "name"
+    void (*handler)(const char* arg);  // arg is "" for SHELL_ARG_NONE
+    const char* help;
+} shell_command_t;
+
+// Registers `count` commands; the table must outlive the registry
+void shell_register(const shell_command_t* cmds, int count);
+bool shell_dispatch(const char* line);
+void shell_print_help(void);
+
+#endif // SHELL_H
@@ -0,0 +1,121 @@
+#include "slab.h"
+#include "heap.h"
+#include <stdint.h>
+
+// Object caches for fixed-size kernel structures.
+//
+// A slab is one SLAB_SIZE-aligned chunk from the heap: a small header followed
+// by equally sized objects. Free objects are chained through their first word,
+// so allocation and release are a list push/pop with no constructor call. The
+// owning slab of an object is found by masking its address.
+
+typedef struct slab {
+    struct slab* next;
+    struct slab* prev;
+    void* free;
+    size_t inuse;
+} slab_t;
+
+slab_cache_t* slab_caches = NULL;
+
+static inline slab_t* slab_of(void* obj) {
+    return (slab_t*)((uintptr_t)obj & ~(uintptr_t)(SLAB_SIZE - 1));
+}
+
+static void slab_unlink(slab_t** list, slab_t* s) {
+    if (s->prev) s->prev->next = s->next;
+    else *list = s->next;
+    if (s->next) s->next->prev = s->prev;
+}
+
+static void slab_push(slab_t** list, slab_t* s) {
+    s->prev = NULL;
+    s->next = *list;
+    if (s->next) s->next->prev = s;
+    *list = s;
+}
+
+static void cache_setup(slab_cache_t* cache) {
+    size_t align = sizeof(void*);
+    if ((cache->flags & SLAB_HWCACHE_ALIGN) && cache->size > SLAB_CACHE_LINE / 2) {
+        align = SLAB_CACHE_LINE;
+    }
+    size_t size = cache->size < sizeof(void*) ? sizeof(void*) : cache->size;
+    cache->obj_size = (size + align - 1) & ~(align - 1);
+    cache->first_obj = (sizeof(slab_t) + align - 1) & ~(align - 1);
+    cache->per_slab = (SLAB_SIZE - cache->first_obj) / cache->obj_size;
+    cache->next = slab_caches;
+    slab_caches = cache;
+}
+
+static slab_t* cache_grow(slab_cache_t* cache) {
+    if (!cache->per_slab) {
+        cache_setup(cache);
+        if (!cache->per_slab) return NULL;
+    }
+
+    slab_t* s = (slab_t*)my_malloc_aligned(SLAB_SIZE, SLAB_SIZE, HEAP_TAG_SLAB);
+    if (!s) return NULL;
+
+    cache->slabs++;
+    s->inuse = 0;
+    s->free = NULL;
+    char* obj = (char*)s + cache->first_obj + (cache->per_slab - 1) * cache->obj_size;
+    for (size_t i = 0; i < cache->per_slab; i++, obj -= cache->obj_size) {
+        *(void**)obj = s->free;
+        s->free = obj;
+    }
+    return s;
+}
+
+void* slab_alloc(slab_cache_t* cache) {
+    slab_t* s = cache->partial;
+    if (!s) {
+        s = cache->empty;
+        if (s) {
+            cache->empty = NULL;
+        } else {
+            s = cache_grow(cache);
+            if (!s) return NULL;
+        }
+        slab_push(&cache->partial, s);
+    }
+
+    void* obj = s->free;
+    s->free = *(void**)obj;
+    s->inuse++;
+    cache->active++;
+
+    if (!s->free) {
+        slab_unlink(&cache->partial, s);
+        slab_push(&cache->full, s);
+    }
+    return obj;
+}
+
+void slab_free(slab_cache_t* cache, void* obj) {
+    if (!obj) return;
+    slab_t* s = slab_of(obj);
+
+    if (!s->free) {
+        slab_unlink(&cache->full, s);
+        slab_push(&cache->partial, s);
+    }
+
+    *(void**)obj = s->free;
+    s->free = obj;
+    s->inuse--;
+    cache->active--;
+
+    // Keep one empty slab around so alloc/free churn at a slab boundary
+    // doesn't bounce memory through the heap.
+    if (s->inuse == 0) {
+        slab_unlink(&cache->partial, s);
+        if (cache->empty) {
+            cache->slabs--;
+            my_free(s);
+        } else {
+            cache->empty = s;
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef SLAB_H
+#define SLAB_H
+#include <stddef.h>
+
+#define SLAB_SIZE 4096
+#define SLAB_CACHE_LINE 64
+
+// Cache flags
+#define SLAB_HWCACHE_ALIGN 0x1  // align objects to a cache line
+
+struct slab;
+
+typedef struct slab_cache {
+    const char* name;
+    size_t size;
+    unsigned int flags;
+    // Filled in on first use
+    size_t obj_size;
+    size_t first_obj;
+    size_t per_slab;
+    struct slab* partial;
+    struct slab* full;
+    struct slab* empty;
+    size_t active;
+    size_t slabs;
+    struct slab_cache* next;
+} slab_cache_t;
+
+// All caches that have allocated at least once
+extern slab_cache_t* slab_caches;
+
+#define SLAB_CACHE_INIT(cache_name, obj_type, cache_flags) \
+    { .name = (cache_name), .size = sizeof(obj_type), .flags = (cache_flags) }
+
+void* slab_alloc(slab_cache_t* cache);
+void slab_free(slab_cache_t* cache, void* obj);
+
+#endif // SLAB_H
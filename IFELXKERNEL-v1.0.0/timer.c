@@ -0,0 +1,68 @@
+#include "timer.h"
+#include "idt.h"
+#include "io.h"
+
+#define PIT_CHANNEL0 0x40
+#define PIT_COMMAND  0x43
+#define PIT_BASE_HZ  1193182u
+
+volatile uint64_t tick_count = 0;
+
+static uint32_t hz = 0;
+static volatile uint32_t seconds = 0;
+static uint32_t second_ticks = 0;
+
+static void timer_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    tick_count++;
+    if (++second_ticks == hz) {
+        second_ticks = 0;
+        seconds++;
+    }
+}
+
+void timer_init(uint32_t rate) {
+    if (rate < 19) rate = 19;  // the divisor is 16 bits
+    if (rate > PIT_BASE_HZ) rate = PIT_BASE_HZ;
+    uint32_t divisor = PIT_BASE_HZ / rate;
+    hz = PIT_BASE_HZ / divisor;
+
+    outb(PIT_COMMAND, 0x36);  // channel 0, lobyte/hibyte, square wave
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
+    irq_install(IRQ_TIMER, timer_irq);
+}
+
+uint32_t timer_hz(void) {
+    return hz;
+}
+
+// A 64-bit read is two loads on i386, so keep the handler out in between
+uint64_t timer_ticks(void) {
+    uint32_t flags = irq_save();
+    uint64_t t = tick_count;
+    irq_restore(flags);
+    return t;
+}
+
+uint32_t timer_seconds(void) {
+    return seconds;
+}
+
+void timer_wait(uint32_t ticks) {
+    uint64_t end = timer_ticks() + ticks;
+    for (;;) {
+        irq_disable();
+        if (tick_count >= end) break;
+        cpu_wait();
+    }
+    irq_enable();
+}
+
+void sleep_ms(uint32_t ms) {
+    if (!hz) return;
+    // 32-bit math only (no libgcc for 64-bit division). Round up, plus one
+    // tick because the first one may be almost over already.
+    uint32_t ticks = (ms / 1000) * hz + ((ms % 1000) * hz + 999) / 1000;
+    timer_wait(ticks + 1);
+}
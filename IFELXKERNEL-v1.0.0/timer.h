@@ -0,0 +1,21 @@
+#ifndef TIMER_H
+#define TIMER_H
+#include <stdint.h>
+
+// PIT channel 0 on IRQ 0. tick_count counts interrupts since timer_init.
+
+#define TIMER_DEFAULT_HZ 1000
+
+extern volatile uint64_t tick_count;
+
+void timer_init(uint32_t hz);
+uint32_t timer_hz(void);
+uint64_t timer_ticks(void);
+// Whole seconds since timer_init, kept by the handler so readers need no
+// 64-bit division
+uint32_t timer_seconds(void);
+// Both halt between ticks instead of spinning
+void timer_wait(uint32_t ticks);
+void sleep_ms(uint32_t ms);
+
+#endif // TIMER_H
@@ -0,0 +1,386 @@
+#include "vfs.h"
+#include "heap.h"
+#include "slab.h"
+#include "mini_string.h"
+#include <stdint.h>
+
+// --- in-memory backing store --------------------------------------------
+
+static slab_cache_t node_cache = SLAB_CACHE_INIT("fs_node", fs_node_t, SLAB_HWCACHE_ALIGN);
+
+static fs_node_t* ramfs_lookup(fs_node_t* dir, const istr_t* name) {
+    return (fs_node_t*)dir_index_find(&dir->data.folder.index, name);
+}
+
+static fs_node_t* ramfs_create(fs_node_t* dir, const istr_t* name, node_type_t type) {
+    (void)dir;
+    fs_node_t* node = (fs_node_t*)slab_alloc(&node_cache);
+    if (!node) return NULL;
+    memset(node, 0, sizeof(*node));
+    node->name = name;
+    node->type = type;
+    node->ops = &ramfs_ops;
+    if (type == TYPE_FILE) node->data.file.tag = HEAP_TAG_FILE;
+    return node;
+}
+
+static void free_chunks(fs_chunk_t* c) {
+    while (c) {
+        fs_chunk_t* next = c->next;
+        my_free(c);
+        c = next;
+    }
+}
+
+static void ramfs_release(fs_node_t* node) {
+    if (node->type == TYPE_FILE) {
+        free_chunks(node->data.file.head);
+    } else {
+        dir_index_free(&node->data.folder.index);
+    }
+    intern_release(node->name);
+    slab_free(&node_cache, node);
+}
+
+static size_t ramfs_read(fs_node_t* file, size_t off, void* buf, size_t len) {
+    size_t size = file->data.file.size;
+    if (off >= size) return 0;
+    if (len > size - off) len = size - off;
+
+    // Resume from the cursor unless the read starts before it
+    fs_chunk_t* c = file->data.file.head;
+    size_t base = 0;
+    if (file->data.file.cursor && file->data.file.cursor_off <= off) {
+        c = file->data.file.cursor;
+        base = file->data.file.cursor_off;
+    }
+    while (off - base >= FS_CHUNK_DATA) {
+        c = c->next;
+        base += FS_CHUNK_DATA;
+    }
+
+    char* out = (char*)buf;
+    size_t in = off - base;
+    size_t done = 0;
+    for (;;) {
+        size_t n = c->used - in;
+        if (n > len - done) n = len - done;
+        memcpy(out + done, c->data + in, n);
+        done += n;
+        if (done == len) break;
+        c = c->next;
+        base += FS_CHUNK_DATA;
+        in = 0;
+    }
+    file->data.file.cursor = c;
+    file->data.file.cursor_off = base;
+    return len;
+}
+
+static bool ramfs_append(fs_node_t* file, const void* data, size_t len) {
+    fs_chunk_t* tail = file->data.file.tail;
+    size_t room = tail ? FS_CHUNK_DATA - tail->used : 0;
+
+    // Allocate every chunk up front so running out of memory changes nothing
+    fs_chunk_t* fresh = NULL;
+    fs_chunk_t* last = NULL;
+    if (len > room) {
+        size_t need = (len - room + FS_CHUNK_DATA - 1) / FS_CHUNK_DATA;
+        for (size_t i = 0; i < need; i++) {
+            fs_chunk_t* c = (fs_chunk_t*)my_malloc_tag(sizeof(fs_chunk_t), file->data.file.tag);
+            if (!c) {
+                free_chunks(fresh);
+                return false;
+            }
+            c->next = NULL;
+            c->used = 0;
+            if (last) last->next = c;
+            else fresh = c;
+            last = c;
+        }
+    }
+
+    const char* src = (const char*)data;
+    size_t left = len;
+    if (room) {
+        size_t n = left < room ? left : room;
+        memcpy(tail->data + tail->used, src, n);
+        tail->used += n;
+        src += n;
+        left -= n;
+    }
+    if (fresh) {
+        if (tail) tail->next = fresh;
+        else file->data.file.head = fresh;
+        for (fs_chunk_t* c = fresh; c; c = c->next) {
+            size_t n = left < FS_CHUNK_DATA ? left : FS_CHUNK_DATA;
+            memcpy(c->data, src, n);
+            c->used = n;
+            src += n;
+            left -= n;
+        }
+        file->data.file.tail = last;
+    }
+    file->data.file.size += len;
+    return true;
+}
+
+static bool ramfs_truncate(fs_node_t* file, size_t size) {
+    size_t old = file->data.file.size;
+    if (size > old) {
+        // Grow with zeros, undoing a partial extension if memory runs out
+        static const char zeros[256];
+        while (file->data.file.size < size) {
+            size_t n = size - file->data.file.size;
+            if (n > sizeof(zeros)) n = sizeof(zeros);
+            if (!ramfs_append(file, zeros, n)) {
+                ramfs_truncate(file, old);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    file->data.file.cursor = NULL;
+    file->data.file.cursor_off = 0;
+    file->data.file.size = size;
+    if (size == 0) {
+        free_chunks(file->data.file.head);
+        file->data.file.head = NULL;
+        file->data.file.tail = NULL;
+        return true;
+    }
+
+    fs_chunk_t* c = file->data.file.head;
+    size_t base = 0;
+    while (size - base > FS_CHUNK_DATA) {
+        c = c->next;
+        base += FS_CHUNK_DATA;
+    }
+    free_chunks(c->next);
+    c->next = NULL;
+    c->used = size - base;
+    file->data.file.tail = c;
+    return true;
+}
+
+const vnode_ops_t ramfs_ops = {
+    .lookup = ramfs_lookup,
+    .create = ramfs_create,
+    .release = ramfs_release,
+    .read = ramfs_read,
+    .append = ramfs_append,
+    .truncate = ramfs_truncate,
+};
+
+static fs_node_t root_node = {
+    .type = TYPE_FOLDER,
+    .ops = &ramfs_ops,
+    .parent = &root_node,
+};
+fs_node_t* root_dir = &root_node;
+fs_node_t* current_dir = &root_node;
+
+// --- dentry cache ---------------------------------------------------------
+
+// Recent (base directory, path) -> node lookups, direct-mapped. Only hits
+// are cached, so creating a node never invalidates anything; removing one
+// bumps the generation and retires every entry at once.
+#define DCACHE_SLOTS 64
+#define DCACHE_PATH 48
+
+typedef struct {
+    uint32_t hash;
+    uint32_t gen;
+    const fs_node_t* base;
+    fs_node_t* node;
+    char path[DCACHE_PATH];
+} dcache_entry_t;
+
+static dcache_entry_t dcache[DCACHE_SLOTS];
+static uint32_t dcache_gen = 1;
+
+static uint32_t dcache_hash(const fs_node_t* base, const char* path) {
+    return intern_hash(path, strlen(path)) ^ (uint32_t)(uintptr_t)base * 2654435761u;
+}
+
+// --- path walking -----------------------------------------------------------
+
+fs_node_t* vfs_lookup(fs_node_t* dir, const char* name) {
+    if (dir->type != TYPE_FOLDER) return NULL;
+    // A name that was never interned cannot be in any directory
+    const istr_t* key = intern_find(name);
+    return key ? dir->ops->lookup(dir, key) : NULL;
+}
+
+// Walks `path` from its base. With a `leaf` buffer the last component is
+// copied out instead of looked up, and its directory is returned.
+static fs_node_t* walk(const char* path, char* leaf, size_t leaf_size) {
+    fs_node_t* node = *path == '/' ? root_dir : current_dir;
+    const char* p = path;
+
+    for (;;) {
+        while (*p == '/') p++;
+        if (!*p) break;
+        const char* start = p;
+        while (*p && *p != '/') p++;
+        size_t len = (size_t)(p - start);
+        if (len > VFS_NAME_MAX) return NULL;
+
+        const char* rest = p;
+        while (*rest == '/') rest++;
+        if (leaf && !*rest) {
+            if (len >= leaf_size || node->type != TYPE_FOLDER) return NULL;
+            memcpy(leaf, start, len);
+            leaf[len] = '\0';
+            return node;
+        }
+
+        if (node->type != TYPE_FOLDER) return NULL;
+        if (len == 1 && start[0] == '.') continue;
+        if (len == 2 && start[0] == '.' && start[1] == '.') {
+            node = node->parent;
+            continue;
+        }
+        const istr_t* key = intern_find_n(start, len);
+        node = key ? node->ops->lookup(node, key) : NULL;
+        if (!node) return NULL;
+    }
+    // A path with no components has no leaf to hand back
+    return leaf ? NULL : node;
+}
+
+fs_node_t* vfs_resolve(const char* path) {
+    if (!path || !*path) return NULL;
+
+    const fs_node_t* base = *path == '/' ? root_dir : current_dir;
+    size_t len = strlen(path);
+    if (len >= DCACHE_PATH) return walk(path, NULL, 0);
+
+    uint32_t h = dcache_hash(base, path);
+    dcache_entry_t* e = &dcache[h % DCACHE_SLOTS];
+    if (e->gen == dcache_gen && e->hash == h && e->base == base &&
+        strcmp(e->path, path) == 0) {
+        return e->node;
+    }
+
+    fs_node_t* node = walk(path, NULL, 0);
+    if (node) {
+        e->hash = h;
+        e->gen = dcache_gen;
+        e->base = base;
+        e->node = node;
+        memcpy(e->path, path, len + 1);
+    }
+    return node;
+}
+
+fs_node_t* vfs_resolve_parent(const char* path, char* leaf, size_t leaf_size) {
+    if (!path || !*path) return NULL;
+    return walk(path, leaf, leaf_size);
+}
+
+// --- namespace changes -------------------------------------------------------
+
+fs_node_t* vfs_create(fs_node_t* dir, const char* name, node_type_t type) {
+    if (dir->type != TYPE_FOLDER || !*name || strlen(name) > VFS_NAME_MAX) return NULL;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) return NULL;
+    for (const char* c = name; *c; c++) {
+        if (*c == '/') return NULL;
+    }
+    const istr_t* key = intern(name);
+    if (!key) return NULL;
+    if (dir->ops->lookup(dir, key)) {
+        intern_release(key);
+        return NULL;
+    }
+
+    // The node owns this reference to its name from here on
+    fs_node_t* node = dir->ops->create(dir, key, type);
+    if (!node) {
+        intern_release(key);
+        return NULL;
+    }
+    if (!dir_index_insert(&dir->data.folder.index, node->name, node)) {
+        node->ops->release(node);
+        return NULL;
+    }
+
+    node->parent = dir;
+    node->dirty = true;
+    node->prev = NULL;
+    node->next = dir->data.folder.children;
+    if (node->next) node->next->prev = node;
+    dir->data.folder.children = node;
+    return node;
+}
+
+bool vfs_unlink(fs_node_t* node) {
+    if (node == root_dir) return false;
+    if (node->type == TYPE_FOLDER && node->data.folder.children) return false;
+
+    fs_node_t* dir = node->parent;
+    dir_index_remove(&dir->data.folder.index, node->name);
+    if (node->prev) node->prev->next = node->next;
+    else dir->data.folder.children = node->next;
+    if (node->next) node->next->prev = node->prev;
+
+    if (current_dir == node) current_dir = dir;
+    dcache_gen++;
+    node->ops->release(node);
+    return true;
+}
+
+// --- file content ---------------------------------------------------------
+
+size_t fs_read(fs_node_t* file, size_t off, void* buf, size_t len) {
+    if (file->type != TYPE_FILE) return 0;
+    return file->ops->read(file, off, buf, len);
+}
+
+bool fs_append(fs_node_t* file, const void* data, size_t len) {
+    if (file->type != TYPE_FILE) return false;
+    if (len == 0) return true;
+    if (!file->ops->append(file, data, len)) return false;
+    file->dirty = true;
+    return true;
+}
+
+bool fs_truncate(fs_node_t* file, size_t size) {
+    if (file->type != TYPE_FILE) return false;
+    if (!file->ops->truncate(file, size)) return false;
+    file->dirty = true;
+    return true;
+}
+
+bool vfs_chdir(const char* path) {
+    fs_node_t* node = vfs_resolve(path);
+    if (!node || node->type != TYPE_FOLDER) return false;
+    current_dir = node;
+    return true;
+}
+
+// Absolute path of `node`, built leaf-first from the end of `buf`. Paths too
+// long for the buffer keep their deepest components.
+void vfs_path(const fs_node_t* node, char* buf, size_t size) {
+    if (size < 2) {
+        if (size) buf[0] = '\0';
+        return;
+    }
+    if (node == root_dir) {
+        buf[0] = '/';
+        buf[1] = '\0';
+        return;
+    }
+
+    size_t pos = size - 1;
+    buf[pos] = '\0';
+    for (; node != root_dir; node = node->parent) {
+        size_t len = node->name->len;
+        if (len + 1 > pos) break;
+        pos -= len;
+        memcpy(buf + pos, node->name->str, len);
+        buf[--pos] = '/';
+    }
+    memmove(buf, buf + pos, size - pos);
+}
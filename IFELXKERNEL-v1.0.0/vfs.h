@@ -0,0 +1,98 @@
+#ifndef VFS_H
+#define VFS_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "dirindex.h"
+#include "heap.h"
+
+#define VFS_NAME_MAX 255
+#define VFS_PATH_MAX 1024
+
+// File system node types
+typedef enum {
+    TYPE_FILE,
+    TYPE_FOLDER
+} node_type_t;
+
+struct vnode_ops;
+
+// File bodies are chains of fixed-size chunks; every chunk but the tail is
+// full, so appends never copy and offsets map to chunks by division.
+#define FS_CHUNK_SIZE 512
+
+typedef struct fs_chunk {
+    struct fs_chunk* next;
+    size_t used;
+    char data[FS_CHUNK_SIZE - 2 * sizeof(size_t)];
+} fs_chunk_t;
+
+#define FS_CHUNK_DATA sizeof(((fs_chunk_t*)0)->data)
+
+// File system node. Files and folders share one namespace per directory;
+// siblings are linked newest first for listings and indexed by name.
+typedef struct fs_node {
+    const istr_t* name;       // interned, one reference held; NULL for the root
+    node_type_t type;
+    const struct vnode_ops* ops;
+    struct fs_node* parent;   // the root is its own parent
+    struct fs_node* next;
+    struct fs_node* prev;
+    uint32_t ino;             // on-disk inode, 0 if never synced
+    bool dirty;               // changed since it was last synced
+    union {
+        struct {
+            fs_chunk_t* head;
+            fs_chunk_t* tail;
+            fs_chunk_t* cursor;   // last chunk read, so sequential reads
+            size_t cursor_off;    // never rescan from the head
+            size_t size;
+            heap_tag_t tag;       // chunks are accounted to this heap tag
+            void* backing;        // store-private data for files not in chunks
+        } file;
+        struct {
+            struct fs_node* children;
+            dir_index_t index;
+        } folder;
+    } data;
+} fs_node_t;
+
+// Operations a backing store provides for its nodes
+typedef struct vnode_ops {
+    fs_node_t* (*lookup)(fs_node_t* dir, const istr_t* name);
+    fs_node_t* (*create)(fs_node_t* dir, const istr_t* name, node_type_t type);
+    void (*release)(fs_node_t* node);   // node is already detached
+    size_t (*read)(fs_node_t* file, size_t off, void* buf, size_t len);
+    bool (*append)(fs_node_t* file, const void* data, size_t len);
+    bool (*truncate)(fs_node_t* file, size_t size);
+} vnode_ops_t;
+
+// In-memory store: nodes from vfs_create start with these, and other
+// stores fall back to them once a file's body is copied into RAM
+extern const vnode_ops_t ramfs_ops;
+
+extern fs_node_t* root_dir;
+extern fs_node_t* current_dir;
+
+// Paths are absolute ("/a/b") or relative to current_dir, and may use
+// "." and ".."; repeated slashes are ignored.
+fs_node_t* vfs_resolve(const char* path);
+// Resolves everything but the last component, which is copied to `leaf`
+fs_node_t* vfs_resolve_parent(const char* path, char* leaf, size_t leaf_size);
+
+fs_node_t* vfs_lookup(fs_node_t* dir, const char* name);
+// NULL if the name exists or memory runs out; check with vfs_lookup first
+fs_node_t* vfs_create(fs_node_t* dir, const char* name, node_type_t type);
+// Folders must be empty; the root cannot be removed
+bool vfs_unlink(fs_node_t* node);
+
+// File content. fs_read returns the bytes copied, short only at end of
+// file; fs_append and fs_truncate leave the file unchanged on failure.
+size_t fs_read(fs_node_t* file, size_t off, void* buf, size_t len);
+bool fs_append(fs_node_t* file, const void* data, size_t len);
+bool fs_truncate(fs_node_t* file, size_t size);
+
+bool vfs_chdir(const char* path);
+void vfs_path(const fs_node_t* node, char* buf, size_t size);
+
+#endif // VFS_H
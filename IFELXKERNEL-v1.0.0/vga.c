@@ -3,18 +3,178 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include "mini_string.h"
+#include "io.h"
+#include "raster.h"
+#include "fbcon.h"
+#include "serial.h"
+#include <stdbool.h>
 
 static uint16_t* const VGA_MEMORY = (uint16_t*)0xB8000;
 static uint8_t vga_color = 0x1F;
 static size_t vga_row = 0, vga_col = 0;
 
+// The 32 KiB text window holds about 200 lines; the screen shows the
+// VGA_HEIGHT lines starting at vga_base, selected by the CRTC start address.
+// Scrolling moves that start down a line. When it reaches the end of the
+// window the visible lines are copied back to the top once.
+#define VGA_TEXT_CELLS (0x8000 / 2)
+#define VGA_SCROLL_LIMIT ((VGA_TEXT_CELLS / VGA_WIDTH) * VGA_WIDTH)
+
+static size_t vga_base = 0;
+static bool vga_hw_scroll = false;
+static bool vga_in_graphics = false;
+
+// With a framebuffer console the grid is larger than 80x25; the shadow is
+// sized for the largest grid and vga_cols/vga_rows give the one in use.
+#define VGA_MAX_COLS 128
+#define VGA_MAX_ROWS 48
+
+static size_t vga_cols = VGA_WIDTH, vga_rows = VGA_HEIGHT;
+static bool vga_fb = false;
+
+// Characters are written to a RAM shadow of the screen and copied to VGA
+// memory by vga_flush. The shadow is a ring of rows starting at shadow_top,
+// so scrolling it is O(1) too. Each physical shadow row keeps a dirty column
+// span [dirty_lo, dirty_hi); scrolls are counted and applied in one go.
+static uint16_t shadow[VGA_MAX_ROWS][VGA_MAX_COLS];
+static size_t shadow_top = 0;
+static uint8_t dirty_lo[VGA_MAX_ROWS];
+static uint8_t dirty_hi[VGA_MAX_ROWS];
+static size_t pending_scroll = 0;
+
 static inline uint8_t vga_entry_color(uint8_t fg, uint8_t bg) {
     return fg | bg << 4;
 }
 
+static inline uint16_t* vga_cell(size_t row, size_t col) {
+    return &VGA_MEMORY[vga_base + row * VGA_WIDTH + col];
+}
+
+static inline size_t shadow_index(size_t row) {
+    size_t i = shadow_top + row;
+    return i < vga_rows ? i : i - vga_rows;
+}
+
+static inline void mark_dirty(size_t i, size_t lo, size_t hi) {
+    if (lo < dirty_lo[i]) dirty_lo[i] = (uint8_t)lo;
+    if (hi > dirty_hi[i]) dirty_hi[i] = (uint8_t)hi;
+}
+
+static void vga_set_start(size_t offset) {
+    outb(0x3D4, 0x0C);
+    outb(0x3D5, (offset >> 8) & 0xFF);
+    outb(0x3D4, 0x0D);
+    outb(0x3D5, offset & 0xFF);
+}
+
+static void vga_set_cursor(size_t offset) {
+    outb(0x3D4, 0x0E);
+    outb(0x3D5, (offset >> 8) & 0xFF);
+    outb(0x3D4, 0x0F);
+    outb(0x3D5, offset & 0xFF);
+}
+
+// Checks that the CRTC start address register takes and holds a value.
+static bool vga_probe_start(void) {
+    vga_set_start(VGA_WIDTH);
+    outb(0x3D4, 0x0C);
+    uint8_t hi = inb(0x3D5);
+    outb(0x3D4, 0x0D);
+    uint8_t lo = inb(0x3D5);
+    vga_set_start(0);
+    return ((hi << 8) | lo) == VGA_WIDTH;
+}
+
+// Text lines are an even number of cells, so they move as 32-bit words.
+static void vga_fill_line(uint16_t* line, uint16_t blank) {
+    uint32_t* d = (uint32_t*)line;
+    uint32_t v = blank | ((uint32_t)blank << 16);
+    for (size_t i = 0; i < vga_cols / 2; i++) d[i] = v;
+}
+
+static void vga_mark_all_dirty(void) {
+    for (size_t i = 0; i < vga_rows; i++) {
+        dirty_lo[i] = 0;
+        dirty_hi[i] = (uint8_t)vga_cols;
+    }
+}
+
+static void vga_copy_cells(uint16_t* dst, const uint16_t* src, size_t cells) {
+    uint32_t* d = (uint32_t*)dst;
+    const uint32_t* s = (const uint32_t*)src;
+    for (size_t i = 0; i < cells / 2; i++) d[i] = s[i];
+}
+
+// Scrolls the shadow by one line; VGA memory catches up in vga_flush.
+static void vga_scroll(void) {
+    size_t i = shadow_top;
+    shadow_top = shadow_index(1);
+    vga_fill_line(shadow[i], (uint16_t)(' ' | (vga_color << 8)));
+    dirty_lo[i] = 0;
+    dirty_hi[i] = (uint8_t)vga_cols;
+    pending_scroll++;
+    vga_row = vga_rows - 1;
+}
+
+// Applies pending scrolls. Lines already in VGA memory stay where they are
+// when the start address moves, so only the newly exposed rows (already
+// marked dirty) need copying. Otherwise the whole screen is redrawn.
+static void vga_apply_scroll(void) {
+    size_t lines = pending_scroll;
+    pending_scroll = 0;
+
+    bool redraw = true;
+    if (vga_fb) {
+        if (lines < vga_rows) {
+            fbcon_scroll(lines);
+            redraw = false;
+        }
+    } else if (vga_hw_scroll) {
+        size_t next = vga_base + lines * VGA_WIDTH;
+        if (lines < VGA_HEIGHT && next + VGA_HEIGHT * VGA_WIDTH <= VGA_SCROLL_LIMIT) {
+            vga_base = next;
+            redraw = false;
+        } else {
+            vga_base = 0;
+        }
+        vga_set_start(vga_base);
+    }
+
+    if (redraw) vga_mark_all_dirty();
+}
+
+void vga_flush(void) {
+    serial_flush();
+    // Text memory is not mapped in mode 13h; the shadow is repainted on return
+    if (vga_in_graphics) return;
+    if (vga_fb) fbcon_hide_cursor();
+    if (pending_scroll) vga_apply_scroll();
+
+    for (size_t row = 0; row < vga_rows; row++) {
+        size_t i = shadow_index(row);
+        if (dirty_lo[i] >= dirty_hi[i]) continue;
+        if (vga_fb) {
+            fbcon_draw_cells(row, dirty_lo[i], &shadow[i][dirty_lo[i]], dirty_hi[i] - dirty_lo[i]);
+        } else {
+            size_t lo = dirty_lo[i] & ~1u;
+            size_t hi = (dirty_hi[i] + 1) & ~1u;
+            vga_copy_cells(vga_cell(row, lo), &shadow[i][lo], hi - lo);
+        }
+        dirty_lo[i] = (uint8_t)vga_cols;
+        dirty_hi[i] = 0;
+    }
+
+    if (vga_fb) {
+        fbcon_show_cursor(vga_row, vga_col);
+    } else {
+        vga_set_cursor(vga_base + vga_row * VGA_WIDTH + vga_col);
+    }
+}
+
 void vga_init() {
     vga_row = 0;
     vga_col = 0;
+    vga_hw_scroll = vga_probe_start();
     vga_setcolor(VGA_COLOR_WHITE, VGA_COLOR_BLUE);
     vga_clear();
 }
@@ -24,22 +184,25 @@ void vga_setcolor(uint8_t fg, uint8_t bg) {
 }
 
 void vga_clear() {
-    for (size_t y = 0; y < VGA_HEIGHT; y++) {
-        for (size_t x = 0; x < VGA_WIDTH; x++) {
-            VGA_MEMORY[y * VGA_WIDTH + x] = (uint16_t)(' ' | (vga_color << 8));
-        }
+    uint16_t blank = (uint16_t)(' ' | (vga_color << 8));
+    if (vga_base) {
+        vga_base = 0;
+        vga_set_start(0);
+    }
+    shadow_top = 0;
+    pending_scroll = 0;
+    for (size_t i = 0; i < vga_rows; i++) {
+        vga_fill_line(shadow[i], blank);
     }
+    vga_mark_all_dirty();
     vga_row = 0;
     vga_col = 0;
+    vga_flush();
 }
 
-void vga_puts(const char* str) {
-    while (*str) {
-        vga_putc(*str++);
-    }
-}
-
-void vga_putc(char c) {
+// Writes one character to the shadow without touching VGA memory.
+void vga_emit(char c) {
+    serial_putc(c);
     switch (c) {
         case '\n': // سطر جديد
             vga_row++;
@@ -49,20 +212,29 @@ void vga_putc(char c) {
         case '\b': // مسح للخلف
             if (vga_col > 0) {
                 vga_col--;
-                // مسح الحرف الحالي
-                VGA_MEMORY[vga_row * VGA_WIDTH + vga_col] = (uint16_t)(' ' | (vga_color << 8));
             } else if (vga_row > 0) {
                 // الانتقال إلى نهاية السطر السابق
                 vga_row--;
-                vga_col = VGA_WIDTH - 1;
-                VGA_MEMORY[vga_row * VGA_WIDTH + vga_col] = (uint16_t)(' ' | (vga_color << 8));
+                vga_col = vga_cols - 1;
+            } else {
+                break;
+            }
+            // مسح الحرف الحالي
+            {
+                size_t i = shadow_index(vga_row);
+                shadow[i][vga_col] = (uint16_t)(' ' | (vga_color << 8));
+                mark_dirty(i, vga_col, vga_col + 1);
             }
             break;
             
         default: // حرف عادي
-            VGA_MEMORY[vga_row * VGA_WIDTH + vga_col] = (uint16_t)(c | (vga_color << 8));
+            {
+                size_t i = shadow_index(vga_row);
+                shadow[i][vga_col] = (uint16_t)((uint8_t)c | (vga_color << 8));
+                mark_dirty(i, vga_col, vga_col + 1);
+            }
             vga_col++;
-            if (vga_col == VGA_WIDTH) {
+            if (vga_col == vga_cols) {
                 vga_col = 0;
                 vga_row++;
             }
@@ -70,9 +242,21 @@ void vga_putc(char c) {
     }
     
     // التمرير للأسفل إذا لزم الأمر
-    if (vga_row == VGA_HEIGHT) {
-        vga_clear();
+    if (vga_row == vga_rows) {
+        vga_scroll();
+    }
+}
+
+void vga_putc(char c) {
+    vga_emit(c);
+    vga_flush();
+}
+
+void vga_puts(const char* str) {
+    while (*str) {
+        vga_emit(*str++);
     }
+    vga_flush();
 }
 
 void vga_printf(const char* fmt, ...) {
@@ -82,34 +266,210 @@ void vga_printf(const char* fmt, ...) {
     vsnprintf(buffer, sizeof(buffer), fmt, args);
     va_end(args);
     
-    char* ptr = buffer;
-    while (*ptr) {
-        vga_putc(*ptr++);
+    vga_puts(buffer);
+}
+
+// --- mode 13h ---------------------------------------------------------------
+//
+// The kernel runs in protected mode, so the BIOS cannot switch modes for us;
+// the register sets below are written directly. Drawing goes to a back buffer
+// in RAM and vga_present() copies it to 0xA0000 during vertical retrace.
+
+#define VGA_MISC_WRITE 0x3C2
+#define VGA_SEQ_INDEX  0x3C4
+#define VGA_SEQ_DATA   0x3C5
+#define VGA_GC_INDEX   0x3CE
+#define VGA_GC_DATA    0x3CF
+#define VGA_AC_INDEX   0x3C0
+#define VGA_AC_READ    0x3C1
+#define VGA_DAC_INDEX  0x3C8
+#define VGA_DAC_DATA   0x3C9
+#define VGA_INSTAT     0x3DA
+
+#define VGA_NUM_SEQ  5
+#define VGA_NUM_CRTC 25
+#define VGA_NUM_GC   9
+#define VGA_NUM_AC   21
+
+typedef struct {
+    uint8_t misc;
+    uint8_t seq[VGA_NUM_SEQ];
+    uint8_t crtc[VGA_NUM_CRTC];
+    uint8_t gc[VGA_NUM_GC];
+    uint8_t ac[VGA_NUM_AC];
+} vga_regs_t;
+
+// 80x25 text. The attribute palette maps colors 0-15 straight to DAC
+// entries 0-15, which both modes program with the same 16 colors.
+static const vga_regs_t vga_mode_text = {
+    0x67,
+    { 0x03, 0x00, 0x03, 0x00, 0x02 },
+    { 0x5F, 0x4F, 0x50, 0x82, 0x55, 0x81, 0xBF, 0x1F, 0x00, 0x4F, 0x0D, 0x0E,
+      0x00, 0x00, 0x00, 0x50, 0x9C, 0x0E, 0x8F, 0x28, 0x1F, 0x96, 0xB9, 0xA3,
+      0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x0E, 0x00, 0xFF },
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+      0x0C, 0x0D, 0x0E, 0x0F, 0x0C, 0x00, 0x0F, 0x08, 0x00 },
+};
+
+// 320x200, 256 colors, chain-4.
+static const vga_regs_t vga_mode_13h = {
+    0x63,
+    { 0x03, 0x01, 0x0F, 0x00, 0x0E },
+    { 0x5F, 0x4F, 0x50, 0x82, 0x54, 0x80, 0xBF, 0x1F, 0x00, 0x41, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x9C, 0x0E, 0x8F, 0x28, 0x40, 0x96, 0xB9, 0xA3,
+      0xFF },
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x05, 0x0F, 0xFF },
+    { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+      0x0C, 0x0D, 0x0E, 0x0F, 0x41, 0x00, 0x0F, 0x00, 0x00 },
+};
+
+static uint8_t* const VGA_GFX_MEMORY = (uint8_t*)0xA0000;
+static uint8_t vga_back[VGA_GFX_WIDTH * VGA_GFX_HEIGHT] __attribute__((aligned(64)));
+
+static void vga_dac_set(uint8_t index, uint8_t r, uint8_t g, uint8_t b) {
+    outb(VGA_DAC_INDEX, index);
+    outb(VGA_DAC_DATA, r);
+    outb(VGA_DAC_DATA, g);
+    outb(VGA_DAC_DATA, b);
+}
+
+// 0-15 are the usual text colors, 16-231 a 6x6x6 color cube and 232-255 a
+// gray ramp. Components are 6-bit.
+static void vga_load_palette(void) {
+    static const uint8_t ega[16][3] = {
+        {  0,  0,  0 }, {  0,  0, 42 }, {  0, 42,  0 }, {  0, 42, 42 },
+        { 42,  0,  0 }, { 42,  0, 42 }, { 42, 21,  0 }, { 42, 42, 42 },
+        { 21, 21, 21 }, { 21, 21, 63 }, { 21, 63, 21 }, { 21, 63, 63 },
+        { 63, 21, 21 }, { 63, 21, 63 }, { 63, 63, 21 }, { 63, 63, 63 },
+    };
+    static const uint8_t level[6] = { 0, 12, 25, 38, 51, 63 };
+
+    for (int i = 0; i < 16; i++) {
+        vga_dac_set(i, ega[i][0], ega[i][1], ega[i][2]);
+    }
+    int i = 16;
+    for (int r = 0; r < 6; r++) {
+        for (int g = 0; g < 6; g++) {
+            for (int b = 0; b < 6; b++) {
+                vga_dac_set(i++, level[r], level[g], level[b]);
+            }
+        }
+    }
+    for (int k = 0; k < 24; k++) {
+        vga_dac_set(i++, 2 + k * 8 / 3, 2 + k * 8 / 3, 2 + k * 8 / 3);
     }
 }
 
-static inline void outb(uint16_t port, uint8_t val) {
-    __asm__ volatile ("outb %0, %1" : : "a"(val), "Nd"(port));
+// Mode 13h writes through all four planes and overwrites the text font in
+// plane 2, so it is saved before the first switch and put back afterwards.
+#define VGA_FONT_BYTES (256 * 32)
+static uint8_t vga_font[VGA_FONT_BYTES];
+static bool vga_font_saved = false;
+
+static void vga_write_regs(const vga_regs_t* r) {
+    outb(VGA_MISC_WRITE, r->misc);
+
+    for (uint8_t i = 0; i < VGA_NUM_SEQ; i++) {
+        outb(VGA_SEQ_INDEX, i);
+        outb(VGA_SEQ_DATA, r->seq[i]);
+    }
+
+    // CRTC registers 0-7 are write-protected until bit 7 of 0x11 is cleared
+    outb(0x3D4, 0x03);
+    outb(0x3D5, inb(0x3D5) | 0x80);
+    outb(0x3D4, 0x11);
+    outb(0x3D5, inb(0x3D5) & ~0x80);
+    for (uint8_t i = 0; i < VGA_NUM_CRTC; i++) {
+        uint8_t v = r->crtc[i];
+        if (i == 0x03) v |= 0x80;
+        if (i == 0x11) v &= ~0x80;
+        outb(0x3D4, i);
+        outb(0x3D5, v);
+    }
+
+    for (uint8_t i = 0; i < VGA_NUM_GC; i++) {
+        outb(VGA_GC_INDEX, i);
+        outb(VGA_GC_DATA, r->gc[i]);
+    }
+
+    // Reading the status register resets the attribute flip-flop to index
+    for (uint8_t i = 0; i < VGA_NUM_AC; i++) {
+        (void)inb(VGA_INSTAT);
+        outb(VGA_AC_INDEX, i);
+        outb(VGA_AC_INDEX, r->ac[i]);
+    }
+    (void)inb(VGA_INSTAT);
+    outb(VGA_AC_INDEX, 0x20);
+}
+
+// Maps plane 2 alone at 0xA0000 for reading and writing the font.
+static void vga_select_font_plane(void) {
+    outb(VGA_SEQ_INDEX, 0x02); outb(VGA_SEQ_DATA, 0x04);
+    outb(VGA_SEQ_INDEX, 0x04); outb(VGA_SEQ_DATA, 0x06);
+    outb(VGA_GC_INDEX, 0x04);  outb(VGA_GC_DATA, 0x02);
+    outb(VGA_GC_INDEX, 0x05);  outb(VGA_GC_DATA, 0x00);
+    outb(VGA_GC_INDEX, 0x06);  outb(VGA_GC_DATA, 0x04);
+}
+
+static void vga_save_font(void) {
+    vga_select_font_plane();
+    for (size_t i = 0; i < VGA_FONT_BYTES; i++) vga_font[i] = VGA_GFX_MEMORY[i];
+    vga_write_regs(&vga_mode_text);
+    // The text register set maps attributes straight to DAC 0-15
+    vga_load_palette();
+    vga_font_saved = true;
+}
+
+static void vga_restore_font(void) {
+    vga_select_font_plane();
+    for (size_t i = 0; i < VGA_FONT_BYTES; i++) VGA_GFX_MEMORY[i] = vga_font[i];
+    vga_write_regs(&vga_mode_text);
+}
+
+static inline void vga_copy_dwords(void* dst, const void* src, size_t count) {
+    __asm__ volatile ("cld; rep movsl"
+                      : "+D"(dst), "+S"(src), "+c"(count)
+                      :
+                      : "memory");
+}
+
+static inline void vga_fill_dwords(void* dst, uint32_t value, size_t count) {
+    __asm__ volatile ("cld; rep stosl"
+                      : "+D"(dst), "+c"(count)
+                      : "a"(value)
+                      : "memory");
 }
 
 void vga_set_graphics_mode() {
-    // Set VGA mode 13h (320x200, 256 colors)
-    __asm__ volatile ("int $0x10" : : "a"(0x0013));
+    if (vga_fb) fbcon_disable();
+    if (!vga_font_saved) vga_save_font();
+    vga_write_regs(&vga_mode_13h);
+    vga_load_palette();
+    vga_in_graphics = true;
 }
 
 void vga_set_pixel(int x, int y, uint8_t color) {
-    if (x >= 0 && x < 320 && y >= 0 && y < 200) {
-        uint8_t* vga_mem = (uint8_t*)0xA0000;
-        vga_mem[y * 320 + x] = color;
+    if ((unsigned)x < VGA_GFX_WIDTH && (unsigned)y < VGA_GFX_HEIGHT) {
+        vga_back[y * VGA_GFX_WIDTH + x] = color;
     }
 }
 
+uint8_t* vga_backbuffer(void) {
+    return vga_back;
+}
+
 void vga_clear_graphics() {
-    for (int y = 0; y < 200; y++) {
-        for (int x = 0; x < 320; x++) {
-            vga_set_pixel(x, y, 0);
-        }
-    }
+    vga_fill_dwords(vga_back, 0, sizeof(vga_back) / 4);
+}
+
+// Waits for the start of the next vertical retrace, then copies the whole
+// back buffer to the screen while the beam is off.
+void vga_present(void) {
+    if (!vga_in_graphics) return;
+    while (inb(VGA_INSTAT) & 0x08);
+    while (!(inb(VGA_INSTAT) & 0x08));
+    vga_copy_dwords(VGA_GFX_MEMORY, vga_back, sizeof(vga_back) / 4);
 }
 
 void vga_putn(int n) {
@@ -120,7 +480,7 @@ void vga_putn(int n) {
 
     // Handle negative numbers
     if (n < 0) {
-        vga_putc('-');
+        vga_emit('-');
         n = -n;
     }
 
@@ -135,40 +495,56 @@ void vga_putn(int n) {
     
     // Print in correct order
     while (--i >= 0) {
-        vga_putc(buffer[i]);
+        vga_emit(buffer[i]);
     }
+    vga_flush();
 }
 
 // تهيئة وضع الرسوميات (VGA Mode 13h - 320x200 256 colors)
 void vga_init_graphics(void) {
     // تفعيل وضع الرسوميات 320x200x256
+    vga_base = 0;
     vga_set_graphics_mode();
     vga_clear_graphics();
+    vga_present();
 }
 
 // العودة إلى وضع النص (80x25)
 void vga_init_text(void) {
     // تفعيل وضع النص 80x25
-    outb(0x3D4, 0x00);
-    outb(0x3D5, 0x0F);
-    outb(0x3D4, 0x01);
-    outb(0x3D5, 0x00);
-    outb(0x3D4, 0x03);
-    outb(0x3D5, 0x00);
-    outb(0x3D4, 0x05);
-    outb(0x3D5, 0x00);
-    outb(0x3D4, 0x07);
-    outb(0x3D5, 0x00);
-    
-    // إعادة تهيئة VGA
-    vga_init();
+    if (vga_in_graphics) {
+        vga_restore_font();
+        vga_in_graphics = false;
+    }
+    vga_set_start(0);
+    if (vga_fb) fbcon_enable();
+
+    // Mode 13h overwrote text memory; repaint it from the shadow
+    vga_base = 0;
+    pending_scroll = 0;
+    vga_mark_all_dirty();
+    vga_flush();
+}
+
+// Moves the console to the VBE framebuffer when the adapter has one. The
+// glyphs are the VGA font already loaded in plane 2, so this has to run while
+// the card is still in text mode.
+bool vga_init_framebuffer(void) {
+    if (vga_fb) return true;
+    if (!vga_font_saved) vga_save_font();
+    if (!fbcon_init(vga_font)) return false;
+
+    vga_fb = true;
+    vga_cols = fbcon_cols();
+    vga_rows = fbcon_rows();
+    if (vga_cols > VGA_MAX_COLS) vga_cols = VGA_MAX_COLS;
+    if (vga_rows > VGA_MAX_ROWS) vga_rows = VGA_MAX_ROWS;
+    vga_base = 0;
+    vga_clear();
+    return true;
 }
 
 // رسم مستطيل
 void vga_draw_rect(int x, int y, int width, int height, uint8_t color) {
-    for (int dy = 0; dy < height; dy++) {
-        for (int dx = 0; dx < width; dx++) {
-            vga_set_pixel(x + dx, y + dy, color);
-        }
-    }
+    raster_fill_rect(x, y, width, height, color);
 }
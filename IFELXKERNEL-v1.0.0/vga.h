@@ -1,9 +1,12 @@
 #ifndef VGA_H
 #define VGA_H
+#include <stdbool.h>
 #include <stdint.h>
 
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
+#define VGA_GFX_WIDTH 320
+#define VGA_GFX_HEIGHT 200
 
 enum vga_color {
     VGA_COLOR_BLACK = 0,
@@ -28,14 +31,19 @@ void vga_init();
 void vga_setcolor(uint8_t fg, uint8_t bg);
 void vga_clear();
 void vga_putc(char c);
+void vga_emit(char c);  // like vga_putc, but shown only at the next vga_flush
 void vga_puts(const char* str);
 void vga_printf(const char* format, ...);
+void vga_flush(void);
 void vga_init_graphics(void);
 void vga_init_text(void);
+bool vga_init_framebuffer(void);
 void vga_draw_rect(int x, int y, int width, int height, uint8_t color);
 void vga_set_graphics_mode();
 void vga_set_pixel(int x, int y, uint8_t color);
 void vga_clear_graphics();
+void vga_present(void);
+uint8_t* vga_backbuffer(void);
 void vga_putn(int n);
 
 #endif
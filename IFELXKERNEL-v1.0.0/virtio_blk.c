@@ -0,0 +1,452 @@
+#include "virtio_blk.h"
+#include "pci.h"
+#include "pmm.h"
+#include "paging.h"
+#include "idt.h"
+#include "io.h"
+#include "mini_string.h"
+
+#define VIRTIO_VENDOR         0x1AF4
+#define VIRTIO_BLK_TRANSITION 0x1001    // legacy registers, often modern ones too
+#define VIRTIO_BLK_MODERN     0x1042
+
+#define STATUS_ACK         0x01
+#define STATUS_DRIVER      0x02
+#define STATUS_DRIVER_OK   0x04
+#define STATUS_FEATURES_OK 0x08
+
+#define F_RO        (1u << 5)
+#define F_FLUSH     (1u << 9)
+#define F_VERSION_1 (1u << 0)   // feature bit 32, in the high word
+
+// Legacy registers in the I/O BAR
+#define LEG_DEVICE_FEATURES 0x00
+#define LEG_DRIVER_FEATURES 0x04
+#define LEG_QUEUE_PFN       0x08
+#define LEG_QUEUE_SIZE      0x0C
+#define LEG_QUEUE_SELECT    0x0E
+#define LEG_QUEUE_NOTIFY    0x10
+#define LEG_STATUS          0x12
+#define LEG_ISR             0x13
+#define LEG_CONFIG          0x14
+
+// Modern common configuration structure
+#define COM_DEVICE_FEATURE_SELECT 0x00
+#define COM_DEVICE_FEATURE        0x04
+#define COM_DRIVER_FEATURE_SELECT 0x08
+#define COM_DRIVER_FEATURE        0x0C
+#define COM_STATUS                0x14
+#define COM_QUEUE_SELECT          0x16
+#define COM_QUEUE_SIZE            0x18
+#define COM_QUEUE_ENABLE          0x1C
+#define COM_QUEUE_NOTIFY_OFF      0x1E
+#define COM_QUEUE_DESC            0x20
+#define COM_QUEUE_DRIVER          0x28
+#define COM_QUEUE_DEVICE          0x30
+
+// Vendor capability types pointing at the modern structures
+#define CAP_COMMON 1
+#define CAP_NOTIFY 2
+#define CAP_ISR    3
+#define CAP_DEVICE 4
+
+#define DESC_NEXT  1
+#define DESC_WRITE 2    // device writes this buffer
+
+#define REQ_IN    0
+#define REQ_OUT   1
+#define REQ_FLUSH 4
+
+#define QUEUE_MAX 256
+#define RESET_TIMEOUT 1000000  // status polls before giving up on a reset
+
+typedef struct {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} vq_desc_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} vq_avail_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t len;
+} vq_used_elem_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    vq_used_elem_t ring[];
+} vq_used_t;
+
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} req_header_t;
+
+static struct {
+    bool modern;
+    uint16_t io;                // legacy register base
+    volatile uint8_t* common;
+    volatile uint8_t* isr;
+    volatile uint8_t* config;
+    volatile uint16_t* notify;
+    uint16_t qsize;
+    vq_desc_t* desc;
+    vq_avail_t* avail;
+    volatile vq_used_t* used;
+    uint16_t used_seen;
+    uint16_t slots;             // each request owns three descriptors
+    bool has_irq;
+    bool flush;
+    bool read_only;
+} vq;
+
+// Per-slot request state; the device reads headers and writes status
+static req_header_t headers[VIRTIO_BLK_SLOTS];
+static volatile uint8_t req_status[VIRTIO_BLK_SLOTS];
+static volatile bool slot_busy[VIRTIO_BLK_SLOTS];
+static volatile uint32_t in_flight = 0;
+static volatile bool batch_failed = false;
+
+static blkdev_t virtio_disk;
+
+static inline void barrier(void) {
+    __asm__ volatile ("" : : : "memory");
+}
+
+static inline uint8_t mmio_read8(volatile uint8_t* base, uint32_t off) {
+    return *(volatile uint8_t*)(base + off);
+}
+
+static inline uint16_t mmio_read16(volatile uint8_t* base, uint32_t off) {
+    return *(volatile uint16_t*)(base + off);
+}
+
+static inline uint32_t mmio_read32(volatile uint8_t* base, uint32_t off) {
+    return *(volatile uint32_t*)(base + off);
+}
+
+static inline void mmio_write8(volatile uint8_t* base, uint32_t off, uint8_t v) {
+    *(volatile uint8_t*)(base + off) = v;
+}
+
+static inline void mmio_write16(volatile uint8_t* base, uint32_t off, uint16_t v) {
+    *(volatile uint16_t*)(base + off) = v;
+}
+
+static inline void mmio_write32(volatile uint8_t* base, uint32_t off, uint32_t v) {
+    *(volatile uint32_t*)(base + off) = v;
+}
+
+static uint8_t get_status(void) {
+    return vq.modern ? mmio_read8(vq.common, COM_STATUS) : inb(vq.io + LEG_STATUS);
+}
+
+static void set_status(uint8_t status) {
+    if (vq.modern) mmio_write8(vq.common, COM_STATUS, status);
+    else outb(vq.io + LEG_STATUS, status);
+}
+
+// --- completion -----------------------------------------------------------
+
+// Retires finished requests. Runs in the interrupt handler and, with
+// interrupts off, from the waiting code.
+static void reap(void) {
+    while (vq.used_seen != vq.used->idx) {
+        barrier();
+        uint32_t id = vq.used->ring[vq.used_seen % vq.qsize].id;
+        uint32_t slot = id / 3;
+        if (slot < vq.slots && slot_busy[slot]) {
+            if (req_status[slot] != 0) batch_failed = true;
+            slot_busy[slot] = false;
+            in_flight--;
+        }
+        vq.used_seen++;
+    }
+}
+
+static void virtio_irq(interrupt_frame_t* frame) {
+    (void)frame;
+    // Reading the ISR status acknowledges the interrupt
+    if (vq.modern) mmio_read8(vq.isr, 0);
+    else inb(vq.io + LEG_ISR);
+    reap();
+}
+
+// Sleeps until fewer than `limit` requests are in flight
+static void wait_below(uint32_t limit) {
+    uint32_t flags = irq_save();
+    for (;;) {
+        irq_disable();
+        reap();
+        if (in_flight < limit) break;
+        // Halting needs the interrupt to wake us; otherwise poll
+        if (vq.has_irq && (flags & 0x200)) cpu_wait();
+        else io_wait();
+    }
+    irq_restore(flags);
+}
+
+// --- submission -------------------------------------------------------------
+
+static void submit(uint32_t type, uint32_t lba, void* buf, uint32_t count) {
+    wait_below(vq.slots);
+    uint32_t slot = 0;
+    while (slot_busy[slot]) slot++;
+
+    headers[slot].type = type;
+    headers[slot].reserved = 0;
+    headers[slot].sector = lba;
+    req_status[slot] = 0xFF;
+
+    // Identity-mapped memory: a pointer is its own bus address
+    uint16_t d = (uint16_t)(slot * 3);
+    vq.desc[d].addr = (uintptr_t)&headers[slot];
+    vq.desc[d].len = sizeof(req_header_t);
+    vq.desc[d].flags = DESC_NEXT;
+    vq.desc[d].next = d + 1;
+    if (count) {
+        vq.desc[d + 1].addr = (uintptr_t)buf;
+        vq.desc[d + 1].len = count * BLKDEV_SECTOR_SIZE;
+        vq.desc[d + 1].flags = DESC_NEXT | (type == REQ_IN ? DESC_WRITE : 0);
+        vq.desc[d + 1].next = d + 2;
+    } else {
+        vq.desc[d].next = d + 2;
+    }
+    vq.desc[d + 2].addr = (uintptr_t)&req_status[slot];
+    vq.desc[d + 2].len = 1;
+    vq.desc[d + 2].flags = DESC_WRITE;
+    vq.desc[d + 2].next = 0;
+
+    uint32_t flags = irq_save();
+    irq_disable();
+    slot_busy[slot] = true;
+    in_flight++;
+    irq_restore(flags);
+
+    vq.avail->ring[vq.avail->idx % vq.qsize] = d;
+    barrier();
+    vq.avail->idx++;
+    barrier();
+    if (vq.modern) *vq.notify = 0;
+    else outw(vq.io + LEG_QUEUE_NOTIFY, 0);
+}
+
+// Queues the whole transfer as up to VIRTIO_BLK_SLOTS concurrent requests,
+// then waits for all of them
+static bool transfer(uint32_t type, uint32_t lba, uint32_t count, void* buf) {
+    if (lba + count > virtio_disk.sectors || lba + count < lba) return false;
+    batch_failed = false;
+    uint8_t* p = (uint8_t*)buf;
+    while (count) {
+        uint32_t n = count < VIRTIO_BLK_REQ_SECTORS ? count : VIRTIO_BLK_REQ_SECTORS;
+        submit(type, lba, p, n);
+        p += n * BLKDEV_SECTOR_SIZE;
+        lba += n;
+        count -= n;
+    }
+    wait_below(1);
+    return !batch_failed;
+}
+
+static bool virtio_read(blkdev_t* dev, uint32_t lba, uint32_t count, void* buf) {
+    (void)dev;
+    return transfer(REQ_IN, lba, count, buf);
+}
+
+static bool virtio_write(blkdev_t* dev, uint32_t lba, uint32_t count, const void* buf) {
+    (void)dev;
+    if (vq.read_only) return false;
+    return transfer(REQ_OUT, lba, count, (void*)buf);
+}
+
+static bool virtio_flush(blkdev_t* dev) {
+    (void)dev;
+    // Without the flush feature the device has no volatile cache
+    if (!vq.flush) return true;
+    batch_failed = false;
+    submit(REQ_FLUSH, 0, NULL, 0);
+    wait_below(1);
+    return !batch_failed;
+}
+
+static blkdev_t virtio_disk = {
+    .name = "vda",
+    .read = virtio_read,
+    .write = virtio_write,
+    .flush = virtio_flush,
+};
+
+// --- setup ------------------------------------------------------------------
+
+// Maps the structure a vendor capability points at; NULL if unusable
+static volatile uint8_t* map_cap(pci_addr_t addr, uint8_t cap) {
+    uint8_t bar = pci_read8(addr, (uint8_t)(cap + 4));
+    uint32_t offset = pci_read32(addr, (uint8_t)(cap + 8));
+    uint32_t length = pci_read32(addr, (uint8_t)(cap + 12));
+    if (bar > 5 || pci_bar_is_high(addr, bar)) return NULL;
+    if (pci_read32(addr, (uint8_t)(PCI_BAR0 + bar * 4)) & 1) return NULL;   // I/O BAR
+
+    uintptr_t base = pci_bar_address(addr, bar) + offset;
+    if (!pci_bar_address(addr, bar)) return NULL;
+    // The BAR may share a large page with the write-combined framebuffer
+    paging_map_range(base, length, PAGING_CACHE_UC);
+    paging_set_cache(base, length, PAGING_CACHE_UC);
+    return (volatile uint8_t*)base;
+}
+
+static bool find_modern(pci_addr_t addr) {
+    uint32_t notify_mult = 0;
+    volatile uint8_t* notify_base = NULL;
+    vq.common = vq.isr = vq.config = NULL;
+    for (uint8_t cap = pci_find_capability(addr, PCI_CAP_VENDOR, 0); cap;
+         cap = pci_find_capability(addr, PCI_CAP_VENDOR, cap)) {
+        uint8_t type = pci_read8(addr, (uint8_t)(cap + 3));
+        volatile uint8_t** slot = type == CAP_COMMON ? &vq.common
+                                : type == CAP_ISR ? &vq.isr
+                                : type == CAP_DEVICE ? &vq.config
+                                : type == CAP_NOTIFY ? &notify_base : NULL;
+        // The first structure of each type is the preferred one
+        if (!slot || *slot) continue;
+        *slot = map_cap(addr, cap);
+        if (type == CAP_NOTIFY) notify_mult = pci_read32(addr, (uint8_t)(cap + 16));
+    }
+    if (!vq.common || !vq.isr || !vq.config || !notify_base) return false;
+
+    mmio_write16(vq.common, COM_QUEUE_SELECT, 0);
+    uint16_t off = mmio_read16(vq.common, COM_QUEUE_NOTIFY_OFF);
+    vq.notify = (volatile uint16_t*)(notify_base + off * notify_mult);
+    return true;
+}
+
+static bool negotiate(void) {
+    uint32_t want = F_FLUSH | F_RO;
+    uint32_t features;
+    if (vq.modern) {
+        mmio_write32(vq.common, COM_DEVICE_FEATURE_SELECT, 1);
+        if (!(mmio_read32(vq.common, COM_DEVICE_FEATURE) & F_VERSION_1)) return false;
+        mmio_write32(vq.common, COM_DEVICE_FEATURE_SELECT, 0);
+        features = mmio_read32(vq.common, COM_DEVICE_FEATURE) & want;
+        mmio_write32(vq.common, COM_DRIVER_FEATURE_SELECT, 0);
+        mmio_write32(vq.common, COM_DRIVER_FEATURE, features);
+        mmio_write32(vq.common, COM_DRIVER_FEATURE_SELECT, 1);
+        mmio_write32(vq.common, COM_DRIVER_FEATURE, F_VERSION_1);
+        set_status(STATUS_ACK | STATUS_DRIVER | STATUS_FEATURES_OK);
+        if (!(get_status() & STATUS_FEATURES_OK)) return false;
+    } else {
+        features = inl(vq.io + LEG_DEVICE_FEATURES) & want;
+        outl(vq.io + LEG_DRIVER_FEATURES, features);
+    }
+    vq.flush = features & F_FLUSH;
+    vq.read_only = features & F_RO;
+    return true;
+}
+
+static bool setup_queue(void) {
+    uint16_t size;
+    if (vq.modern) {
+        mmio_write16(vq.common, COM_QUEUE_SELECT, 0);
+        size = mmio_read16(vq.common, COM_QUEUE_SIZE);
+        // Modern devices accept a smaller ring than their maximum
+        if (size > QUEUE_MAX) size = QUEUE_MAX;
+    } else {
+        outw(vq.io + LEG_QUEUE_SELECT, 0);
+        size = inw(vq.io + LEG_QUEUE_SIZE);
+    }
+    if (size < 3 || size > 32768) return false;
+
+    // Legacy layout: descriptors and available ring, then the used ring on
+    // the next page boundary
+    uint32_t used_off = (16u * size + 6 + 2u * size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint32_t bytes = used_off + ((6 + 8u * size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+    uintptr_t ring = pmm_alloc_frames(bytes / PAGE_SIZE);
+    if (!ring) return false;
+    memset((void*)ring, 0, bytes);
+
+    vq.qsize = size;
+    vq.desc = (vq_desc_t*)ring;
+    vq.avail = (vq_avail_t*)(ring + 16u * size);
+    vq.used = (volatile vq_used_t*)(ring + used_off);
+    vq.used_seen = 0;
+    vq.slots = size / 3 < VIRTIO_BLK_SLOTS ? size / 3 : VIRTIO_BLK_SLOTS;
+
+    if (vq.modern) {
+        mmio_write16(vq.common, COM_QUEUE_SIZE, size);
+        mmio_write32(vq.common, COM_QUEUE_DESC, (uint32_t)ring);
+        mmio_write32(vq.common, COM_QUEUE_DESC + 4, 0);
+        mmio_write32(vq.common, COM_QUEUE_DRIVER, (uint32_t)(uintptr_t)vq.avail);
+        mmio_write32(vq.common, COM_QUEUE_DRIVER + 4, 0);
+        mmio_write32(vq.common, COM_QUEUE_DEVICE, (uint32_t)(uintptr_t)vq.used);
+        mmio_write32(vq.common, COM_QUEUE_DEVICE + 4, 0);
+        mmio_write16(vq.common, COM_QUEUE_ENABLE, 1);
+    } else {
+        outl(vq.io + LEG_QUEUE_PFN, (uint32_t)(ring / PAGE_SIZE));
+    }
+    return true;
+}
+
+blkdev_t* virtio_blk_init(void) {
+    const pci_device_t* dev = NULL;
+    for (int i = 0; i < pci_scan(); i++) {
+        const pci_device_t* d = pci_device(i);
+        if (d->vendor == VIRTIO_VENDOR &&
+            (d->device == VIRTIO_BLK_TRANSITION || d->device == VIRTIO_BLK_MODERN)) {
+            dev = d;
+            break;
+        }
+    }
+    if (!dev) return NULL;
+
+    pci_enable(dev->addr, PCI_CMD_IO | PCI_CMD_MEMORY | PCI_CMD_MASTER);
+    memset(&vq, 0, sizeof(vq));
+    vq.modern = find_modern(dev->addr);
+    if (!vq.modern) {
+        // Transitional devices also expose the legacy registers in BAR0
+        uint32_t bar0 = pci_read32(dev->addr, PCI_BAR0);
+        if (dev->device != VIRTIO_BLK_TRANSITION || !(bar0 & 1)) return NULL;
+        vq.io = (uint16_t)pci_bar_address(dev->addr, 0);
+    }
+
+    set_status(0);
+    if (vq.modern) {
+        // A device that never finishes resetting is left alone; boot then
+        // falls back to ATA
+        uint32_t i = 0;
+        while (get_status() != 0) {
+            if (++i == RESET_TIMEOUT) return NULL;
+            io_wait();
+        }
+    }
+    set_status(STATUS_ACK);
+    set_status(STATUS_ACK | STATUS_DRIVER);
+    if (!negotiate() || !setup_queue()) {
+        set_status(0);
+        return NULL;
+    }
+
+    if (dev->irq != PCI_IRQ_NONE) {
+        irq_install(dev->irq, virtio_irq);
+        vq.has_irq = true;
+    }
+    uint8_t ok = STATUS_ACK | STATUS_DRIVER | STATUS_DRIVER_OK;
+    set_status(vq.modern ? ok | STATUS_FEATURES_OK : ok);
+
+    // Capacity in 512-byte sectors; the block layer addresses 32 bits
+    uint32_t lo, hi;
+    if (vq.modern) {
+        lo = mmio_read32(vq.config, 0);
+        hi = mmio_read32(vq.config, 4);
+    } else {
+        lo = inl(vq.io + LEG_CONFIG);
+        hi = inl(vq.io + LEG_CONFIG + 4);
+    }
+    virtio_disk.sectors = hi ? 0xFFFFFFFFu : lo;
+    return virtio_disk.sectors ? &virtio_disk : NULL;
+}
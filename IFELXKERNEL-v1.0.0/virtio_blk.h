@@ -0,0 +1,15 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+#include "blkdev.h"
+
+// virtio-blk over PCI (QEMU -drive if=virtio), legacy or modern transport.
+// One split virtqueue keeps several requests in flight; completions arrive
+// by interrupt and the CPU halts while it waits for them.
+
+#define VIRTIO_BLK_SLOTS 16         // requests in flight at once
+#define VIRTIO_BLK_REQ_SECTORS 128  // larger transfers are split into 64 KiB requests
+
+// Probes the PCI bus; NULL if there is no usable virtio disk
+blkdev_t* virtio_blk_init(void);
+
+#endif // VIRTIO_BLK_H
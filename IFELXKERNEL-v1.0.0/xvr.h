@@ -0,0 +1,132 @@
+#ifndef XVR_H
+#define XVR_H
+#include <stdbool.h>
+#include <stddef.h>
+#include "intern.h"
+
+// Data model of the C/Python compiler and the XVR virtual machine in
+// commands.c, shared with the host benchmark so it sizes jobs the same way.
+
+// Per-job capacity limits
+#define MAX_TOKENS 2000
+#define MAX_VARIABLES 200
+#define MAX_STACK_SIZE 1000
+#define MAX_BYTECODE 5000
+
+typedef enum {
+    TOKEN_NUMBER,
+    TOKEN_STRING,
+    TOKEN_IDENTIFIER,
+    TOKEN_PLUS,
+    TOKEN_MINUS,
+    TOKEN_MULTIPLY,
+    TOKEN_DIVIDE,
+    TOKEN_ASSIGN,
+    TOKEN_SEMICOLON,
+    TOKEN_LPAREN,
+    TOKEN_RPAREN,
+    TOKEN_LBRACE,
+    TOKEN_RBRACE,
+    TOKEN_IF,
+    TOKEN_WHILE,
+    TOKEN_FOR,
+    TOKEN_INT,
+    TOKEN_CHAR,
+    TOKEN_PRINTF,
+    TOKEN_RETURN,
+    TOKEN_MAIN,
+    TOKEN_EOF,
+    TOKEN_NEWLINE,
+    TOKEN_COMMA,
+    TOKEN_EQUALS,
+    TOKEN_LESS,
+    TOKEN_GREATER,
+    TOKEN_AND,
+    TOKEN_OR,
+    TOKEN_DEF,
+    TOKEN_PRINT,
+    TOKEN_INPUT,
+    TOKEN_COLON,
+    TOKEN_INDENT,
+    TOKEN_DEDENT,
+    TOKEN_INCLUDE,
+    TOKEN_VOID
+} TokenType;
+
+typedef struct {
+    TokenType type;
+    const istr_t* value;    // copy in the job arena, not interned
+    int int_value;
+    int line;
+} Token;
+
+typedef enum {
+    VAR_INT,
+    VAR_STRING,
+    VAR_CHAR,
+    VAR_FLOAT
+} VarType;
+
+typedef struct {
+    char name[64];
+    VarType type;
+    union {
+        int int_val;
+        char str_val[256];
+        char char_val;
+        float float_val;
+    } value;
+    bool is_global;
+} Variable;
+
+// Bytecode instructions for XVR format
+typedef enum {
+    OP_LOAD_CONST,
+    OP_LOAD_VAR,
+    OP_STORE_VAR,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_PRINT,
+    OP_PRINTF,
+    OP_CALL,
+    OP_RETURN,
+    OP_JUMP,
+    OP_JUMP_IF_FALSE,
+    OP_COMPARE,
+    OP_HALT,
+    OP_INPUT,
+    OP_GRAPHICS_MODE,
+    OP_DRAW_PIXEL,
+    OP_DRAW_LINE,
+    OP_DRAW_RECT
+} OpCode;
+
+typedef struct {
+    OpCode op;
+    int arg1;
+    int arg2;
+    const istr_t* str_arg;  // in the job arena; istr_empty when unused
+} Instruction;
+
+// .xvr image layout: this header, then the instruction records, variables
+// and constants in that order
+typedef struct {
+    int bytecode_count;
+    int var_count;
+    int const_count;
+} XvrHeader;
+
+// Instruction as stored in an .xvr image. Its operand string follows
+// inline, padded to 4 bytes, and is copied into the job arena on load.
+typedef struct {
+    int op;
+    int arg1;
+    int arg2;
+    int str_len;
+} XvrInstruction;
+
+#define XVR_STR_SPACE(len) (((len) + 3) & ~(size_t)3)
+
+#endif // XVR_H